@@ -1,15 +1,43 @@
 #include "app.h"
 
-int app_init(App *app)
+#include <math.h>
+
+#define APP_PLOT_POINTS 1024
+
+static int app_init_graphics(App *app, int flags,
+			     const struct graphics_config *config)
 {
+	if(flags & app_headless_flag)
+		app->graphics = graphics_new_headless(600, 600, config);
+	else
+		app->graphics = graphics_new(app->window, config);
+
+	if(!app->graphics)
+		return -1;
+
+	if(flags & app_cached_commands_flag)
+		graphics_cache_commands(app->graphics, 1);
+
+	return 0;
+}
+
+int app_init(App *app, int flags, const struct graphics_config *config)
+{
+	app->flags = flags;
+	app->frame = 0;
+
+	if(flags & app_headless_flag) {
+		app->window = 0;
+
+		return app_init_graphics(app, flags, config);
+	}
+
 	app->window = window_new(600, 600, "test");
 	
 	if(!app->window)
 		return -1;
 
-	app->graphics = graphics_new(app->window);
-
-	if(!app->graphics) {
+	if(app_init_graphics(app, flags, config) == -1) {
 		window_delete(app->window);
 		return -1;
 	}
@@ -17,8 +45,126 @@ int app_init(App *app)
 	return 0;
 }
 
+/* drains pending window events, returns -1 once the window is closed */
+int app_poll(App *app)
+{
+	window_event_t event;
+
+	if(!app->window)
+		return 0;
+
+	while(window_poll_event(app->window, &event)) {
+		int closed = 0;
+
+		switch (event.event_type) {
+		case resize_event_type:
+			graphics_window_resized(app->graphics);
+			break;
+		case close_event_type:
+			closed = 1;
+			break;
+		}
+
+		window_event_destroy(&event);
+
+		if(closed)
+			return -1;
+	}
+
+	return 0;
+}
+
+int app_set_instance_grid(App *app, uint32_t instances_n)
+{
+	uint32_t side = 1;
+
+	while(side * side < instances_n)
+		side++;
+
+	struct graphics_instance *instances =
+		malloc(sizeof(struct graphics_instance) * instances_n);
+
+	if(!instances)
+		return -1;
+
+	float cell = 2.0f / side;
+
+	for(uint32_t i = 0; i < instances_n; i++) {
+		uint32_t x = i % side;
+		uint32_t y = i / side;
+
+		instances[i] = (struct graphics_instance) {
+			.offset = {-1 + cell * (x + 0.5f), -1 + cell * (y + 0.5f)},
+			.scale = cell,
+			.color = {(float) x / side, (float) y / side, 1}
+		};
+	}
+
+	int res = graphics_set_instances(app->graphics, instances, instances_n);
+
+	free(instances);
+
+	return res;
+}
+
+/* a scrolling sine wave, rebuilt from scratch every frame */
+static int app_stream_plot(App *app)
+{
+	static struct graphics_vertex vertices[APP_PLOT_POINTS * 2];
+	static uint32_t indices[(APP_PLOT_POINTS - 1) * 6];
+
+	const float width = 0.01f;
+	float phase = app->frame * 0.05f;
+
+	for(uint32_t i = 0; i < APP_PLOT_POINTS; i++) {
+		float x = -1 + 2.0f * i / (APP_PLOT_POINTS - 1);
+		float y = 0.5f * sinf(x * 6 + phase);
+
+		vertices[i * 2] = (struct graphics_vertex) {
+			.pos = {x, y - width},
+			.color = {0, 1, 0}
+		};
+		vertices[i * 2 + 1] = (struct graphics_vertex) {
+			.pos = {x, y + width},
+			.color = {0, 1, 0}
+		};
+	}
+
+	for(uint32_t i = 0; i < APP_PLOT_POINTS - 1; i++) {
+		uint32_t *quad = indices + i * 6;
+		uint32_t v = i * 2;
+
+		quad[0] = v;
+		quad[1] = v + 2;
+		quad[2] = v + 1;
+		quad[3] = v + 1;
+		quad[4] = v + 2;
+		quad[5] = v + 3;
+	}
+
+	return graphics_stream_geometry(app->graphics, vertices,
+					APP_PLOT_POINTS * 2, indices,
+					(APP_PLOT_POINTS - 1) * 6);
+}
+
+int app_frame(App *app)
+{
+	if((app->flags & app_stream_plot_flag) && app_stream_plot(app) == -1)
+		pdebug("plot streaming error");
+
+	/* the frames in between draw with the new swapchain */
+	if((app->flags & app_resize_storm_flag) && !(app->frame & 1))
+		graphics_window_resized(app->graphics);
+
+	app->frame++;
+
+	return draw_frame(app->graphics);
+}
+
 void app_destroy(App *app)
 {
-	window_delete(app->window);
+	if(app->window)
+		window_delete(app->window);
+
 	graphics_delete(app->graphics);
 }
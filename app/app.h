@@ -1,3 +1,6 @@
+#ifndef APP_H
+#define APP_H
+
 #include <graphics/setup.h>
 #include <window/window.h>
 #include <window/vksurface.h>
@@ -9,12 +12,29 @@
 #include <string.h>
 #include <unistd.h>
 
+enum app_init_flags {
+	app_headless_flag = 1,
+	app_cached_commands_flag = 2,
+	app_stream_plot_flag = 4,
+	/* requests a swapchain recreation every other frame */
+	app_resize_storm_flag = 8
+};
+
 typedef struct App {
 	Window *window;
 	Graphics *graphics;	
+
+	int flags;
+	uint64_t frame;
 } App;
 
-int app_init(App *app);
+/* a null config uses the default presentation policy */
+int app_init(App *app, int flags, const struct graphics_config *config);
+int app_poll(App *app);
+/* produces this frame's dynamic geometry and draws it */
+int app_frame(App *app);
+/* lays instances_n copies of the mesh out on a square grid */
+int app_set_instance_grid(App *app, uint32_t instances_n);
 void app_destroy(App *app);
 
-
+#endif
@@ -0,0 +1,235 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <helpers/timer.h>
+
+enum bench_series {
+	bench_frame_series = graphics_phases_n,
+	bench_gpu_renderpass_series,
+	bench_gpu_draw_series,
+	bench_series_n
+};
+
+static const char *const series_names[bench_series_n] = {
+	[graphics_phase_fence_wait] = "fence_wait",
+	[graphics_phase_acquire] = "acquire",
+	[graphics_phase_record] = "record",
+	[graphics_phase_submit] = "submit",
+	[graphics_phase_present] = "present",
+	[graphics_phase_recreate] = "recreate",
+	[bench_frame_series] = "frame",
+	[bench_gpu_renderpass_series] = "gpu_renderpass",
+	[bench_gpu_draw_series] = "gpu_draw"
+};
+
+static int compare_ns(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+/* nearest-rank percentile of a sorted series */
+static double percentile_us(const uint64_t *sorted, uint32_t n, uint32_t p)
+{
+	uint32_t rank = ((uint64_t) p * n + 99) / 100;
+
+	if(!rank)
+		rank = 1;
+
+	return sorted[rank - 1] / 1000.0;
+}
+
+static void print_series(const char *name, uint64_t *samples, uint32_t n)
+{
+	qsort(samples, n, sizeof(uint64_t), compare_ns);
+
+	printf("\"%s\":{\"min\":%.3f,\"p50\":%.3f,\"p95\":%.3f,"
+	       "\"p99\":%.3f,\"max\":%.3f}",
+	       name, samples[0] / 1000.0, percentile_us(samples, n, 50),
+	       percentile_us(samples, n, 95), percentile_us(samples, n, 99),
+	       samples[n - 1] / 1000.0);
+}
+
+int bench_run(App *app, uint32_t warmup, uint32_t frames)
+{
+	uint32_t errors = 0;
+	uint32_t measured = 0;
+	uint32_t gpu_measured = 0;
+	uint32_t recreated = 0;
+
+	if(!frames)
+		return -1;
+
+	uint64_t *samples = malloc(sizeof(uint64_t) * frames * bench_series_n);
+
+	if(!samples)
+		return -1;
+
+	for(uint32_t i = 0; i < warmup; i++) {
+		if(app_poll(app) == -1)
+			goto closed;
+
+		app_frame(app);
+	}
+
+	uint64_t start = timer_now_ns();
+
+	for(; measured < frames; measured++) {
+		struct graphics_frame_stats stats;
+
+		if(app_poll(app) == -1)
+			break;
+
+		uint64_t frame_start = timer_now_ns();
+
+		if(app_frame(app) == -1)
+			errors++;
+
+		samples[bench_frame_series * frames + measured] =
+			timer_now_ns() - frame_start;
+
+		graphics_get_frame_stats(app->graphics, &stats);
+
+		for(int p = 0; p < graphics_phases_n; p++)
+			samples[p * frames + measured] = stats.phase_ns[p];
+
+		/* recreation latency only over the frames that recreated */
+		if(stats.phase_ns[graphics_phase_recreate])
+			samples[graphics_phase_recreate * frames + recreated++] =
+				stats.phase_ns[graphics_phase_recreate];
+
+		if(!stats.gpu_valid)
+			continue;
+
+		samples[bench_gpu_renderpass_series * frames + gpu_measured] =
+			stats.gpu_renderpass_ns;
+		samples[bench_gpu_draw_series * frames + gpu_measured] =
+			stats.gpu_draw_ns;
+
+		gpu_measured++;
+	}
+
+	uint64_t elapsed = timer_now_ns() - start;
+
+	if(!measured)
+		goto closed;
+
+	printf("{\"warmup\":%u,\"frames\":%u,\"errors\":%u,\"fps\":%.2f,"
+	       "\"unit\":\"us\",\"phases\":{",
+	       warmup, measured, errors, measured * 1e9 / elapsed);
+
+	for(int s = 0; s <= bench_frame_series; s++) {
+		if(s == graphics_phase_recreate)
+			continue;
+
+		if(s)
+			printf(",");
+
+		print_series(series_names[s], samples + s * frames, measured);
+	}
+
+	if(recreated) {
+		printf(",");
+		print_series(series_names[graphics_phase_recreate],
+			     samples + graphics_phase_recreate * frames, recreated);
+	}
+
+	/* gpu samples lag the cpu ones and are absent without timestamps */
+	for(int s = bench_frame_series + 1; gpu_measured && s < bench_series_n;
+	    s++) {
+		printf(",");
+		print_series(series_names[s], samples + s * frames,
+			     gpu_measured);
+	}
+
+	printf("}");
+
+	struct graphics_chunk_stats chunks;
+
+	graphics_get_chunk_stats(app->graphics, &chunks);
+
+	if(chunks.chunks_n)
+		printf(",\"chunks\":{\"chunks\":%u,\"slots\":%u,"
+		       "\"resident\":%u,\"loads\":%llu,\"evictions\":%llu}",
+		       chunks.chunks_n, chunks.slots_n, chunks.resident_n,
+		       (unsigned long long) chunks.loads,
+		       (unsigned long long) chunks.evictions);
+
+	printf("}\n");
+
+	free(samples);
+
+	return 0;
+
+closed:
+	free(samples);
+
+	return -1;
+}
+
+int bench_particles(App *app, uint32_t warmup, uint32_t frames, uint32_t max)
+{
+	if(!frames || max < BENCH_PARTICLES_MIN)
+		return -1;
+
+	uint64_t *samples = malloc(sizeof(uint64_t) * frames * 2);
+
+	if(!samples)
+		return -1;
+
+	uint64_t *frame_samples = samples;
+	uint64_t *wait_samples = samples + frames;
+	int res = 0;
+
+	for(uint32_t n = BENCH_PARTICLES_MIN;; n = n > max / 2 ? max : n * 2) {
+		if(graphics_set_particles(app->graphics, n) == -1) {
+			pdebug("failed setting %u particles", n);
+			res = -1;
+			break;
+		}
+
+		uint32_t measured = 0;
+
+		for(uint32_t i = 0; i < warmup + frames; i++) {
+			struct graphics_frame_stats stats;
+
+			if(app_poll(app) == -1)
+				goto closed;
+
+			uint64_t frame_start = timer_now_ns();
+
+			app_frame(app);
+
+			if(i < warmup)
+				continue;
+
+			graphics_get_frame_stats(app->graphics, &stats);
+
+			frame_samples[measured] = timer_now_ns() - frame_start;
+			wait_samples[measured++] =
+				stats.phase_ns[graphics_phase_fence_wait];
+		}
+
+		printf("{\"particles\":%u,\"frames\":%u,\"unit\":\"us\",", n,
+		       measured);
+		print_series("frame", frame_samples, measured);
+		printf(",");
+		print_series("fence_wait", wait_samples, measured);
+		printf("}\n");
+
+		if(n == max)
+			break;
+	}
+
+	graphics_set_particles(app->graphics, 0);
+	free(samples);
+
+	return res;
+
+closed:
+	free(samples);
+
+	return -1;
+}
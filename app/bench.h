@@ -0,0 +1,27 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#include "app.h"
+
+/*
+ * Draws warmup unmeasured frames, then frames measured ones and prints
+ * per-phase CPU time percentiles and frames per second as JSON to stdout.
+ * Swapchain recreation latency is reported over the frames that recreated,
+ * run with --resize-storm to force one every other frame.
+ */
+int bench_run(App *app, uint32_t warmup, uint32_t frames);
+
+/* smallest particle count bench_particles measures */
+#define BENCH_PARTICLES_MIN (1u << 14)
+
+/*
+ * Measures frame time against GPU particle count, doubling it from
+ * BENCH_PARTICLES_MIN up to max. Prints one JSON line per count with the
+ * frame and fence wait percentiles, the latter growing once the GPU
+ * becomes the bottleneck.
+ */
+int bench_particles(App *app, uint32_t warmup, uint32_t frames, uint32_t max);
+
+#endif
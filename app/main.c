@@ -1,59 +1,231 @@
 #include "app.h"
+#include "bench.h"
+#include "ondemand.h"
 #include "helpers/helpers.h"
 #include "window/window.h"
+#include <stdio.h>
+
+#define BENCH_WARMUP_FRAMES 100
+#define CHUNK_BUDGET_MIB 64
+/* top of the particle sweep without --particles */
+#define PARTICLE_BENCH_MAX (1u << 22)
 
 enum app_flags {
 	app_running = 1,
-	app_poll = 2
+	app_bench = 2,
+	app_on_demand = 4,
+	app_particle_bench = 8
 };
 
-int main(void) 
+static int parse_present_mode(const char *name)
+{
+	static const char *const names[] = {
+		[graphics_present_immediate] = "immediate",
+		[graphics_present_mailbox] = "mailbox",
+		[graphics_present_fifo] = "fifo",
+		[graphics_present_fifo_relaxed] = "fifo-relaxed"
+	};
+
+	for(int i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if(names[i] && !strcmp(name, names[i]))
+			return i;
+	}
+
+	return -1;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [--headless] [--cached] [--threads <n>] "
+		"[--instances <n>] [--stream] [--resize-storm] "
+		"[--resize-settle <ms>] "
+		"[--chunks <file>] [--chunk-budget <MiB>] [--frames <n>] "
+		"[--bench <frames>] [--warmup <frames>] "
+		"[--on-demand] [--animate <hz>] [--low-latency] [--throughput] "
+		"[--present <immediate|mailbox|fifo|fifo-relaxed>] "
+		"[--frames-inflight <n>] [--images <n>] [--particles <n>] "
+		"[--particle-bench <frames>] [--gpu-cull]\n", name);
+}
+
+int main(int argc, char **argv)
 {
 	pdebug("starting in debug mode");
 
+	int flags = 0;
+	int state = app_running;
+	long frames = -1;
+	long warmup = BENCH_WARMUP_FRAMES;
+	long threads = 0;
+	long instances = 0;
+	long resize_settle = WINDOW_RESIZE_SETTLE_MS;
+	long animate = 0;
+	int profile = graphics_profile_default;
+	int present_mode = -1;
+	long frames_inflight = -1;
+	long images = -1;
+	const char *chunks = 0;
+	long chunk_budget = CHUNK_BUDGET_MIB;
+	long particles = -1;
+	int gpu_cull = 0;
+
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "--headless")) {
+			flags |= app_headless_flag;
+		} else if(!strcmp(argv[i], "--cached")) {
+			flags |= app_cached_commands_flag;
+		} else if(!strcmp(argv[i], "--stream")) {
+			flags |= app_stream_plot_flag;
+		} else if(!strcmp(argv[i], "--resize-storm")) {
+			flags |= app_resize_storm_flag;
+		} else if(!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			threads = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--instances") && i + 1 < argc) {
+			instances = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--resize-settle") && i + 1 < argc) {
+			resize_settle = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--chunks") && i + 1 < argc) {
+			chunks = argv[++i];
+		} else if(!strcmp(argv[i], "--chunk-budget") && i + 1 < argc) {
+			chunk_budget = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--frames") && i + 1 < argc) {
+			frames = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--bench") && i + 1 < argc) {
+			state |= app_bench;
+			frames = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--particle-bench") && i + 1 < argc) {
+			state |= app_particle_bench;
+			frames = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--particles") && i + 1 < argc) {
+			particles = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--gpu-cull")) {
+			gpu_cull = 1;
+		} else if(!strcmp(argv[i], "--warmup") && i + 1 < argc) {
+			warmup = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--on-demand")) {
+			state |= app_on_demand;
+		} else if(!strcmp(argv[i], "--animate") && i + 1 < argc) {
+			animate = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--low-latency")) {
+			profile = graphics_profile_low_latency;
+		} else if(!strcmp(argv[i], "--throughput")) {
+			profile = graphics_profile_throughput;
+		} else if(!strcmp(argv[i], "--present") && i + 1 < argc) {
+			present_mode = parse_present_mode(argv[++i]);
+
+			if(present_mode == -1) {
+				usage(argv[0]);
+				return -1;
+			}
+		} else if(!strcmp(argv[i], "--frames-inflight") && i + 1 < argc) {
+			frames_inflight = strtol(argv[++i], 0, 10);
+		} else if(!strcmp(argv[i], "--images") && i + 1 < argc) {
+			images = strtol(argv[++i], 0, 10);
+		} else {
+			usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if(threads < 0 || instances < 0 || chunk_budget <= 0 ||
+	   resize_settle < 0 || animate < 0 || animate > UINT32_MAX ||
+	   frames_inflight == 0 || particles < -1 ||
+	   /* nothing would wake a headless on-demand loop but the timer */
+	   ((state & app_on_demand) && (flags & app_headless_flag) &&
+	    !animate) ||
+	   ((state & (app_bench | app_particle_bench)) &&
+	    (frames <= 0 || warmup < 0))) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	struct graphics_config config;
+
+	/* explicit options override the profile */
+	graphics_config_init(&config, profile);
+
+	if(present_mode != -1)
+		config.present_mode = present_mode;
+
+	if(frames_inflight > 0)
+		config.frames_inflight = frames_inflight;
+
+	if(images >= 0)
+		config.images_n = images;
+
 	App app;
 
-	int res = app_init(&app);
-	
+	int res = app_init(&app, flags, &config);
+
 	if(res == -1) {
 		perror("error during app setup");
 		return -1;
 	}
 
-	int state = app_running;
-	
-	do {
+	if(app.window)
+		window_set_resize_settle(app.window, resize_settle);
 
-		window_event_t event;
+	if(threads && graphics_set_record_threads(app.graphics, threads) == -1)
+		pdebug("no worker threads, recording inline");
 
-		state |= app_poll;
+	if(instances && app_set_instance_grid(&app, instances) == -1)
+		pdebug("failed setting %ld instances", instances);
 
-		while(state & app_poll) {
+	if(gpu_cull && graphics_set_gpu_culling(app.graphics, 1) == -1)
+		pdebug("no indirect draws, drawing every instance");
 
+	if(chunks) {
+		/* only clip space is on screen without a camera */
+		static const float view_min[2] = {-1, -1};
+		static const float view_max[2] = {1, 1};
 
-			int res = window_poll_event(app.window, &event);
+		if(graphics_load_chunks(app.graphics, chunks,
+					(uint64_t) chunk_budget << 20) == -1)
+			pdebug("failed loading chunks from %s", chunks);
 
-			if(!res)
-				break;
+		graphics_set_chunk_view(app.graphics, view_min, view_max);
+	}
 
-			switch (event.event_type) {
-			case resize_event_type:
-				graphics_window_resized(app.graphics);
-				break;
-			case close_event_type:
-				state &= ~app_running;
-				state &= ~app_poll;
-				break;
-			}
+	if(state & app_particle_bench) {
+		res = bench_particles(&app, warmup, frames,
+				      particles > 0 ? particles :
+						      PARTICLE_BENCH_MAX);
 
-			window_event_destroy(&event);
-		}
+		app_destroy(&app);
+
+		return res;
+	}
+
+	if(particles > 0 && graphics_set_particles(app.graphics, particles) == -1)
+		pdebug("failed setting %ld particles", particles);
+
+	if(state & app_bench) {
+		res = bench_run(&app, warmup, frames);
 
-		res = draw_frame(app.graphics);
+		app_destroy(&app);
+
+		return res;
+	}
+
+	if(state & app_on_demand) {
+		res = ondemand_run(&app, animate, frames);
+
+		app_destroy(&app);
+
+		return res;
+	}
+
+	do {
+		if(app_poll(&app) == -1)
+			break;
+
+		res = app_frame(&app);
 
 		if(res == -1)
 			pdebug("dra frame error");
 
+		if(frames > 0 && !--frames)
+			state &= ~app_running;
+
 	} while(state & app_running);
 
 	app_destroy(&app);
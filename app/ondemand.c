@@ -0,0 +1,145 @@
+#include "ondemand.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+enum ondemand_sources {
+	ondemand_window_source,
+	ondemand_redraw_source,
+	ondemand_timer_source,
+	ondemand_sources_n
+};
+
+static int watch_fd(int epoll_fd, int fd, uint32_t source)
+{
+	struct epoll_event event = {
+		.events = EPOLLIN,
+		.data.u32 = source
+	};
+
+	return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static int create_timer(uint32_t hz)
+{
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if(fd == -1)
+		return -1;
+
+	/* a zero interval would disarm the timer, rates past 1 GHz tick every ns */
+	long period = 1000000000l / hz;
+
+	if(!period)
+		period = 1;
+
+	struct itimerspec spec = {
+		.it_interval = {
+			.tv_sec = period / 1000000000l,
+			.tv_nsec = period % 1000000000l
+		}
+	};
+
+	spec.it_value = spec.it_interval;
+
+	if(timerfd_settime(fd, 0, &spec, 0) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int ondemand_run(App *app, uint32_t animate_hz, long frames)
+{
+	int res = -1;
+	int timer_fd = -1;
+
+	/* headless, nothing but the timer would ever wake the loop up */
+	if(!app->window && !animate_hz) {
+		errno = EINVAL;
+		goto epoll_error;
+	}
+
+	int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+	if(epoll_fd == -1)
+		goto epoll_error;
+
+	if(app->window &&
+	   watch_fd(epoll_fd, window_get_fd(app->window),
+		    ondemand_window_source) == -1)
+		goto watch_error;
+
+	if(watch_fd(epoll_fd, graphics_get_redraw_fd(app->graphics),
+		    ondemand_redraw_source) == -1)
+		goto watch_error;
+
+	if(animate_hz) {
+		timer_fd = create_timer(animate_hz);
+
+		if(timer_fd == -1 ||
+		   watch_fd(epoll_fd, timer_fd, ondemand_timer_source) == -1)
+			goto watch_error;
+	}
+
+	int redraw = 0;
+
+	for(;;) {
+		/* also drains events xcb queued while presenting */
+		if(app_poll(app) == -1)
+			break;
+
+		if(graphics_redraw_requested(app->graphics))
+			redraw = 1;
+
+		if(redraw) {
+			redraw = 0;
+
+			if(app_frame(app) == -1)
+				pdebug("draw frame error");
+
+			if(frames > 0 && !--frames)
+				break;
+
+			/* poll again before blocking, drawing may queue events */
+			continue;
+		}
+
+		int timeout = app->window ? window_get_timeout(app->window) : -1;
+
+		struct epoll_event events[ondemand_sources_n];
+
+		int events_n = epoll_wait(epoll_fd, events, ondemand_sources_n,
+					  timeout);
+
+		if(events_n == -1 && errno != EINTR)
+			goto wait_error;
+
+		for(int i = 0; i < events_n; i++) {
+			uint64_t ticks;
+
+			/* window and redraw events are picked up above */
+			if(events[i].data.u32 != ondemand_timer_source)
+				continue;
+
+			if(read(timer_fd, &ticks, sizeof(ticks)) == sizeof(ticks))
+				redraw = 1;
+		}
+	}
+
+	res = 0;
+wait_error:
+watch_error:
+	if(timer_fd != -1)
+		close(timer_fd);
+
+	close(epoll_fd);
+epoll_error:
+	if(res == -1)
+		perror("on-demand loop error");
+
+	return res;
+}
@@ -0,0 +1,17 @@
+#ifndef ONDEMAND_H
+#define ONDEMAND_H
+
+#include <stdint.h>
+
+#include "app.h"
+
+/*
+ * Blocks in epoll on the window connection, the graphics redraw eventfd
+ * and, when animate_hz is nonzero, a timerfd ticking at that rate. A frame
+ * is only drawn after a redraw request or a timer tick. Stops once the
+ * window is closed or, when frames is positive, after that many frames.
+ * Without a window animate_hz is required, nothing else would wake it.
+ */
+int ondemand_run(App *app, uint32_t animate_hz, long frames);
+
+#endif
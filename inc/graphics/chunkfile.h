@@ -0,0 +1,38 @@
+#ifndef CHUNKFILE_H
+#define CHUNKFILE_H
+
+#include <stdint.h>
+
+#define CHUNKFILE_MAGIC "VKCM"
+#define CHUNKFILE_VERSION 1
+
+/*
+ * Chunked mesh file, little endian:
+ *
+ *   struct chunkfile_header
+ *   ... chunk data ...
+ *   struct chunkfile_entry[chunks_n] at table_offset
+ *
+ * Every chunk is an independent indexed triangle list: vertices_n
+ * struct graphics_vertex followed by indices_n uint32_t indices relative
+ * to the chunk's first vertex. Chunk offsets are 16-byte aligned.
+ */
+struct chunkfile_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t vertex_size;
+	uint32_t chunks_n;
+	uint64_t table_offset;
+};
+
+struct chunkfile_entry {
+	/* 2D bounds of the chunk's vertices, used for visibility */
+	float min[2];
+	float max[2];
+
+	uint64_t offset;
+	uint32_t vertices_n;
+	uint32_t indices_n;
+};
+
+#endif
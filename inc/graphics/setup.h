@@ -6,11 +6,220 @@
 
 typedef struct Graphics Graphics;
 
-Graphics *graphics_new(Window *window);
+enum graphics_frame_phases {
+	graphics_phase_fence_wait,
+	graphics_phase_acquire,
+	graphics_phase_record,
+	graphics_phase_submit,
+	graphics_phase_present,
+	/* swapchain recreation, zero in frames without one */
+	graphics_phase_recreate,
+	graphics_phases_n
+};
+
+/*
+ * CPU time spent in each phase of the last draw_frame call, and GPU time
+ * of the most recently completed frame when timestamps are supported
+ */
+struct graphics_frame_stats {
+	uint64_t phase_ns[graphics_phases_n];
+
+	int gpu_valid;
+	uint64_t gpu_renderpass_ns;
+	uint64_t gpu_draw_ns;
+};
+
+/* device memory held by the sub-allocator, summed over all memory types */
+struct graphics_memory_stats {
+	uint32_t blocks_n;
+	uint32_t allocations_n;
+	uint64_t reserved_bytes;
+	uint64_t used_bytes;
+
+	uint32_t free_ranges_n;
+	uint64_t largest_free_bytes;
+	/* 1 - largest free range / total free, 0 when free space is contiguous */
+	float fragmentation;
+};
+
+/* layout of the scene mesh's vertices */
+struct graphics_vertex {
+	float pos[2];
+	float color[3];
+};
+
+/*
+ * Per-instance vertex data: every instance draws the whole mesh scaled by
+ * scale around its origin, moved by offset and tinted by color. texture
+ * is an index from graphics_add_texture, 0 is plain white; instances with
+ * any other index are rejected.
+ */
+struct graphics_instance {
+	float offset[2];
+	float scale;
+	float color[3];
+	uint32_t texture;
+};
+
+/* residency of the chunk file loaded with graphics_load_chunks */
+struct graphics_chunk_stats {
+	uint32_t chunks_n;
+	uint32_t slots_n;
+	uint32_t resident_n;
+	uint32_t queued_n;
+	/* chunks drawn by the last frame */
+	uint32_t drawn_n;
+
+	uint64_t loads;
+	uint64_t evictions;
+};
+
+enum graphics_present_modes {
+	/* mailbox when supported, else fifo */
+	graphics_present_default,
+	graphics_present_immediate,
+	graphics_present_mailbox,
+	graphics_present_fifo,
+	graphics_present_fifo_relaxed
+};
+
+enum graphics_profiles {
+	graphics_profile_default,
+	/* one frame in flight and the fewest swapchain images */
+	graphics_profile_low_latency,
+	/* more frames in flight and images to keep the GPU fed */
+	graphics_profile_throughput
+};
+
+/*
+ * Presentation policy. A present mode the surface lacks falls back to
+ * fifo, which is always supported; the image count is clamped to what the
+ * surface allows.
+ */
+struct graphics_config {
+	int present_mode;
+	/* 0 for the default of 2 */
+	uint32_t frames_inflight;
+	/* 0 for one more than the surface minimum */
+	uint32_t images_n;
+};
+
+void graphics_config_init(struct graphics_config *config, int profile);
+
+/* a null config uses graphics_profile_default */
+Graphics *graphics_new(Window *window, const struct graphics_config *config);
+/*
+ * renders into a ring of offscreen images, no window or presentation;
+ * only frames_inflight of the config applies, it is also the ring size
+ */
+Graphics *graphics_new_headless(uint32_t width, uint32_t height,
+				const struct graphics_config *config);
 void graphics_delete(Graphics *graphics);
 
 int draw_frame(Graphics *graphics);
 
 void graphics_window_resized(Graphics *graphics);
 
+/*
+ * On-demand rendering: redraw requests are counted in an eventfd a loop
+ * can block on. Resizes and graphics_scene_dirty request one on their
+ * own, anything else that changes the image (instances, streamed
+ * geometry) needs a graphics_request_redraw. Safe from any thread.
+ */
+void graphics_request_redraw(Graphics *graphics);
+/* clears pending requests, returns whether there were any */
+int graphics_redraw_requested(Graphics *graphics);
+int graphics_get_redraw_fd(const Graphics *graphics);
+
+/*
+ * Records one command buffer per swapchain image and replays it every
+ * frame. Call graphics_scene_dirty after changing anything the recording
+ * captures; swapchain recreation invalidates it on its own. GPU timestamps
+ * are not collected in this mode.
+ */
+void graphics_cache_commands(Graphics *graphics, int enable);
+void graphics_scene_dirty(Graphics *graphics);
+
+/*
+ * Splits scene recording across threads_n worker threads that fill
+ * secondary command buffers; 0 records inline on the calling thread.
+ * Ignored while commands are cached.
+ */
+int graphics_set_record_threads(Graphics *graphics, uint32_t threads_n);
+
+/* replaces all instances, there is one identity instance by default */
+int graphics_set_instances(Graphics *graphics,
+			   const struct graphics_instance *instances,
+			   uint32_t instances_n);
+/* overwrites instances [first, first + instances_n) in place */
+int graphics_update_instances(Graphics *graphics, uint32_t first,
+			      const struct graphics_instance *instances,
+			      uint32_t instances_n);
+
+/*
+ * Queues geometry drawn once, on top of the scene, by the next draw_frame,
+ * or dropped if that frame is skipped to recreate the swapchain.
+ * The data is copied into a persistently mapped per-frame region, which
+ * may wait for the GPU to finish the frame that last used it. Fails when
+ * the frame's region is full or commands are cached.
+ */
+int graphics_stream_geometry(Graphics *graphics,
+			     const struct graphics_vertex *vertices,
+			     uint32_t vertices_n, const uint32_t *indices,
+			     uint32_t indices_n);
+
+/*
+ * Draws a chunk file (see graphics/chunkfile.h) that need not fit in
+ * memory: chunks overlapping the view are read from the mapped file by
+ * a loader thread and uploaded into a device local pool of budget bytes,
+ * evicting the least recently drawn ones. Chunks appear once loaded, so a
+ * frame may draw only part of the view. Not drawn while commands are
+ * cached.
+ */
+int graphics_load_chunks(Graphics *graphics, const char *path,
+			 uint64_t budget);
+void graphics_unload_chunks(Graphics *graphics);
+/* the area chunks must overlap to be drawn, everything by default */
+void graphics_set_chunk_view(Graphics *graphics, const float min[2],
+			     const float max[2]);
+void graphics_get_chunk_stats(const Graphics *graphics,
+			      struct graphics_chunk_stats *stats);
+
+/*
+ * Simulates particles_n particles on the GPU: a compute step integrates
+ * them every frame, bouncing inside clip space, and they are drawn as
+ * points on top of the scene. Runs on an async compute queue when the
+ * device has one. 0 removes them. Not drawn while commands are cached.
+ */
+int graphics_set_particles(Graphics *graphics, uint32_t particles_n);
+
+/*
+ * Culls the instances against the view in a compute pass that writes
+ * their indirect draws, so drawing them costs the CPU the same at any
+ * instance count. Needs multiDrawIndirect, returns -1 without it. Not
+ * used while commands are cached.
+ */
+int graphics_set_gpu_culling(Graphics *graphics, int enable);
+
+/*
+ * Looks at center, scaled by zoom, so that center +- 1 / zoom fills the
+ * view. The camera is a uniform, moving it rewrites no vertex data.
+ */
+void graphics_set_camera(Graphics *graphics, const float center[2],
+			 float zoom);
+
+/*
+ * Uploads a width by height RGBA8 image into the bindless texture array
+ * and returns its index for graphics_instance.texture, so instances with
+ * different textures are still drawn together. Returns -1 when the device
+ * has no descriptor indexing or the array is full.
+ */
+int graphics_add_texture(Graphics *graphics, uint32_t width, uint32_t height,
+			 const uint8_t *rgba, uint32_t *texture);
+
+void graphics_get_frame_stats(const Graphics *graphics,
+			      struct graphics_frame_stats *stats);
+void graphics_get_memory_stats(const Graphics *graphics,
+			       struct graphics_memory_stats *stats);
+
 #endif
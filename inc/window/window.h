@@ -11,6 +11,8 @@ enum window_event_types {
 
 typedef struct Window Window;
 
+#define WINDOW_RESIZE_SETTLE_MS 100
+
 typedef struct window_event {
 	int event_type;
 	struct window_event_info *info;
@@ -22,7 +24,17 @@ void window_delete(Window *window);
 
 void show_window(Window *window);
 
+/*
+ * Size changes are coalesced: a single resize event carrying the final
+ * size is returned once no further change arrived for the settle time
+ */
 int window_poll_event(Window *window, window_event_t *event);
+void window_set_resize_settle(Window *window, uint32_t settle_ms);
+
+/* readable when events may be pending, for blocking in poll/epoll */
+int window_get_fd(const Window *window);
+/* ms until a pending resize settles, -1 when none is pending */
+int window_get_timeout(const Window *window);
 void window_event_destroy(window_event_t *window_event);
 
 uint32_t window_get_height(const Window *window);
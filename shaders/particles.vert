@@ -0,0 +1,18 @@
+#version 450
+layout(location = 0) in vec2 inPosition;
+
+// struct camera_uniform, bound by the scene before the particles draw
+layout(set = 0, binding = 0) uniform Camera {
+    vec2 center;
+    vec2 scale;
+} camera;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = vec4((inPosition - camera.center) * camera.scale, 0.0, 1.0);
+    gl_PointSize = 1.0;
+
+    float hue = fract(float(gl_VertexIndex) * 0.618034);
+    fragColor = vec3(0.4 + 0.6 * hue, 0.5, 1.0 - 0.6 * hue);
+}
@@ -2,10 +2,34 @@
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
+layout(location = 2) in vec2 instOffset;
+layout(location = 3) in float instScale;
+layout(location = 4) in vec3 instColor;
+layout(location = 5) in uint instTexture;
+
+// struct camera_uniform, read at a dynamic offset into the uniform ring
+layout(set = 0, binding = 0) uniform Camera {
+    vec2 center;
+    vec2 scale;
+} camera;
+
+// struct draw_constants
+layout(push_constant) uniform Draw {
+    vec2 offset;
+    float scale;
+} draw;
+
 layout(location = 0) out vec3 fragColor;
+// only read by textured.frag
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragTexture;
 
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
-}
+    vec2 world = (inPosition * instScale + instOffset) * draw.scale + draw.offset;
 
+    gl_Position = vec4((world - camera.center) * camera.scale, 0.0, 1.0);
+    fragColor = inColor * instColor;
+    // the mesh spans [-0.5, 0.5]
+    fragUV = inPosition + 0.5;
+    fragTexture = instTexture;
+}
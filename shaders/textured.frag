@@ -0,0 +1,17 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragTexture;
+
+// the bindless texture array, partially bound so only used slots are valid
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4 texel = texture(textures[nonuniformEXT(fragTexture)], fragUV);
+
+    outColor = vec4(fragColor, 1.0) * texel;
+}
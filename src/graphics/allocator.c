@@ -0,0 +1,401 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "allocator.h"
+#include "vksetup.h"
+
+static inline VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkDeviceSize block_size(const struct allocator *allocator,
+			       uint32_t type)
+{
+	uint32_t heap = allocator->properties.memoryTypes[type].heapIndex;
+	VkDeviceSize heap_size = allocator->properties.memoryHeaps[heap].size;
+
+	/* small heaps such as a 256MB BAR window get proportionally smaller blocks */
+	if(heap_size / 8 < ALLOCATOR_BLOCK_SIZE)
+		return align_up(heap_size / 8, 1 << 20);
+
+	return ALLOCATOR_BLOCK_SIZE;
+}
+
+static struct memory_block *create_block(struct Graphics *graphics,
+					 uint32_t type, VkDeviceSize size,
+					 int kind, int dedicated)
+{
+	struct allocator *allocator = &graphics->allocator;
+
+	struct memory_block *block = calloc(1, sizeof(struct memory_block));
+
+	if(!block)
+		goto block_malloc_error;
+
+	block->free = malloc(sizeof(struct memory_range));
+
+	if(!block->free)
+		goto range_malloc_error;
+
+	*block->free = (struct memory_range) {
+		.offset = 0,
+		.size = size,
+		.next = 0
+	};
+
+	VkMemoryAllocateInfo allocInfo = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = size,
+		.memoryTypeIndex = type
+	};
+
+	VkResult res = vkAllocateMemory(graphics->device, &allocInfo, 0,
+					&block->memory);
+
+	if(res != VK_SUCCESS)
+		goto memory_alloc_error;
+
+	if(allocator->properties.memoryTypes[type].propertyFlags &
+	   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		res = vkMapMemory(graphics->device, block->memory, 0,
+				  VK_WHOLE_SIZE, 0, &block->mapped);
+
+		if(res != VK_SUCCESS)
+			goto memory_map_error;
+	}
+
+	block->size = size;
+	block->type = type;
+	block->kind = kind;
+	block->dedicated = dedicated;
+
+	block->next = allocator->blocks[type];
+	allocator->blocks[type] = block;
+
+	pdebug("allocator: new %s block of %llu bytes in type %u",
+	       dedicated ? "dedicated" : "shared", (unsigned long long) size,
+	       type);
+
+	return block;
+
+memory_map_error:
+	vkFreeMemory(graphics->device, block->memory, 0);
+memory_alloc_error:
+	free(block->free);
+range_malloc_error:
+	free(block);
+block_malloc_error:
+	return 0;
+}
+
+static void destroy_block(struct Graphics *graphics,
+			  struct memory_block *block)
+{
+	if(block->mapped)
+		vkUnmapMemory(graphics->device, block->memory);
+
+	vkFreeMemory(graphics->device, block->memory, 0);
+
+	while(block->free) {
+		struct memory_range *next = block->free->next;
+		free(block->free);
+		block->free = next;
+	}
+
+	free(block);
+}
+
+/* first fit over the free list, splitting the range that fits */
+static int block_alloc(struct memory_block *block, VkDeviceSize size,
+		       VkDeviceSize alignment, VkDeviceSize *offset)
+{
+	for(struct memory_range **link = &block->free; *link;
+	    link = &(*link)->next) {
+		struct memory_range *range = *link;
+
+		VkDeviceSize start = align_up(range->offset, alignment);
+		VkDeviceSize end = start + size;
+		VkDeviceSize range_end = range->offset + range->size;
+
+		if(end > range_end)
+			continue;
+
+		if(start == range->offset) {
+			if(end == range_end) {
+				*link = range->next;
+				free(range);
+			} else {
+				range->offset = end;
+				range->size = range_end - end;
+			}
+		} else if(end == range_end) {
+			range->size = start - range->offset;
+		} else {
+			struct memory_range *tail =
+				malloc(sizeof(struct memory_range));
+
+			if(!tail)
+				return -1;
+
+			*tail = (struct memory_range) {
+				.offset = end,
+				.size = range_end - end,
+				.next = range->next
+			};
+
+			range->size = start - range->offset;
+			range->next = tail;
+		}
+
+		*offset = start;
+		block->used += size;
+		block->allocations_n++;
+
+		return 0;
+	}
+
+	return -1;
+}
+
+static int block_free(struct memory_block *block, VkDeviceSize offset,
+		      VkDeviceSize size)
+{
+	struct memory_range *prev = 0;
+	struct memory_range *next = block->free;
+
+	for(; next && next->offset < offset; prev = next, next = next->next);
+
+	block->used -= size;
+	block->allocations_n--;
+
+	if(prev && prev->offset + prev->size == offset) {
+		prev->size += size;
+
+		if(next && prev->offset + prev->size == next->offset) {
+			prev->size += next->size;
+			prev->next = next->next;
+			free(next);
+		}
+
+		return 0;
+	}
+
+	if(next && offset + size == next->offset) {
+		next->offset = offset;
+		next->size += size;
+
+		return 0;
+	}
+
+	struct memory_range *range = malloc(sizeof(struct memory_range));
+
+	/* losing track of the range only leaks space inside the block */
+	if(!range)
+		return -1;
+
+	*range = (struct memory_range) {
+		.offset = offset,
+		.size = size,
+		.next = next
+	};
+
+	if(prev)
+		prev->next = range;
+	else
+		block->free = range;
+
+	return 0;
+}
+
+void allocator_init(struct Graphics *graphics)
+{
+	struct allocator *allocator = &graphics->allocator;
+
+	memset(allocator, 0, sizeof(struct allocator));
+
+	vkGetPhysicalDeviceMemoryProperties(graphics->physicalDevice,
+					    &allocator->properties);
+}
+
+void allocator_destroy(struct Graphics *graphics)
+{
+	struct allocator *allocator = &graphics->allocator;
+
+	for(int i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+		while(allocator->blocks[i]) {
+			struct memory_block *next = allocator->blocks[i]->next;
+
+			if(allocator->blocks[i]->allocations_n)
+				pdebug("allocator: %u allocations leaked",
+				       allocator->blocks[i]->allocations_n);
+
+			destroy_block(graphics, allocator->blocks[i]);
+			allocator->blocks[i] = next;
+		}
+	}
+}
+
+int allocate_memory(struct Graphics *graphics,
+		    const VkMemoryRequirements *requirements,
+		    VkMemoryPropertyFlags properties, int kind,
+		    struct allocation *allocation)
+{
+	struct allocator *allocator = &graphics->allocator;
+	struct memory_block *block;
+	VkDeviceSize offset;
+
+	int type = find_memory_type(graphics, requirements->memoryTypeBits,
+				    properties);
+
+	if(type == -1)
+		return -1;
+
+	VkDeviceSize size = requirements->size;
+	VkDeviceSize alignment = requirements->alignment ?
+					 requirements->alignment : 1;
+	VkDeviceSize default_size = block_size(allocator, type);
+
+	if(size > default_size / 2) {
+		block = create_block(graphics, type, size, kind, 1);
+
+		if(!block || block_alloc(block, size, 1, &offset) == -1)
+			return -1;
+
+		goto allocated;
+	}
+
+	for(block = allocator->blocks[type]; block; block = block->next) {
+		if(block->dedicated || block->kind != kind ||
+		   block->size - block->used < size)
+			continue;
+
+		if(block_alloc(block, size, alignment, &offset) == 0)
+			goto allocated;
+	}
+
+	block = create_block(graphics, type, default_size, kind, 0);
+
+	if(!block || block_alloc(block, size, alignment, &offset) == -1)
+		return -1;
+
+allocated:
+	*allocation = (struct allocation) {
+		.block = block,
+		.memory = block->memory,
+		.offset = offset,
+		.size = size,
+		.mapped = block->mapped ? (char *) block->mapped + offset : 0
+	};
+
+	return 0;
+}
+
+void free_memory(struct Graphics *graphics, struct allocation *allocation)
+{
+	struct allocator *allocator = &graphics->allocator;
+	struct memory_block *block = allocation->block;
+
+	if(!block)
+		return;
+
+	block_free(block, allocation->offset, allocation->size);
+	allocation->block = 0;
+
+	if(block->allocations_n)
+		return;
+
+	struct memory_block **link = allocator->blocks + block->type;
+	int others = 0;
+
+	for(struct memory_block *b = *link; b; b = b->next)
+		others += b != block && !b->dedicated && b->kind == block->kind;
+
+	/* keep one empty shared block per type around to avoid churn */
+	if(!block->dedicated && !others)
+		return;
+
+	for(; *link != block; link = &(*link)->next);
+
+	*link = block->next;
+	destroy_block(graphics, block);
+}
+
+int allocate_buffer_memory(struct Graphics *graphics, VkBuffer buffer,
+			   VkMemoryPropertyFlags properties,
+			   struct allocation *allocation)
+{
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(graphics->device, buffer, &memRequirements);
+
+	int res = allocate_memory(graphics, &memRequirements, properties,
+				  allocation_linear, allocation);
+
+	if(res == -1)
+		return -1;
+
+	if(vkBindBufferMemory(graphics->device, buffer, allocation->memory,
+			      allocation->offset) != VK_SUCCESS) {
+		free_memory(graphics, allocation);
+		return -1;
+	}
+
+	return 0;
+}
+
+int allocate_image_memory(struct Graphics *graphics, VkImage image,
+			  VkMemoryPropertyFlags properties,
+			  struct allocation *allocation)
+{
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(graphics->device, image, &memRequirements);
+
+	int res = allocate_memory(graphics, &memRequirements, properties,
+				  allocation_optimal, allocation);
+
+	if(res == -1)
+		return -1;
+
+	if(vkBindImageMemory(graphics->device, image, allocation->memory,
+			     allocation->offset) != VK_SUCCESS) {
+		free_memory(graphics, allocation);
+		return -1;
+	}
+
+	return 0;
+}
+
+void allocator_get_stats(const struct allocator *allocator,
+			 struct graphics_memory_stats *stats)
+{
+	uint64_t free_bytes = 0;
+
+	memset(stats, 0, sizeof(struct graphics_memory_stats));
+
+	for(int i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+		for(struct memory_block *block = allocator->blocks[i]; block;
+		    block = block->next) {
+			stats->blocks_n++;
+			stats->allocations_n += block->allocations_n;
+			stats->reserved_bytes += block->size;
+			stats->used_bytes += block->used;
+
+			for(struct memory_range *range = block->free; range;
+			    range = range->next) {
+				stats->free_ranges_n++;
+				free_bytes += range->size;
+
+				if(range->size > stats->largest_free_bytes)
+					stats->largest_free_bytes = range->size;
+			}
+		}
+	}
+
+	if(free_bytes)
+		stats->fragmentation =
+			1.0f - (float) stats->largest_free_bytes / free_bytes;
+}
@@ -0,0 +1,77 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+struct Graphics;
+struct graphics_memory_stats;
+
+#define ALLOCATOR_BLOCK_SIZE (64ull << 20)
+
+/*
+ * Buffers and optimally tiled images never share a block, which keeps
+ * every neighbour pair within a block on the same side of
+ * bufferImageGranularity.
+ */
+enum allocation_kinds {
+	allocation_linear,
+	allocation_optimal,
+	allocation_kinds_n
+};
+
+struct memory_range {
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	struct memory_range *next;
+};
+
+struct memory_block {
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	VkDeviceSize used;
+	uint32_t allocations_n;
+	uint32_t type;
+	int kind;
+	int dedicated;
+	void *mapped;
+
+	/* sorted by offset, neighbours always coalesced */
+	struct memory_range *free;
+
+	struct memory_block *next;
+};
+
+struct allocation {
+	struct memory_block *block;
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	void *mapped;
+};
+
+struct allocator {
+	VkPhysicalDeviceMemoryProperties properties;
+	struct memory_block *blocks[VK_MAX_MEMORY_TYPES];
+};
+
+void allocator_init(struct Graphics *graphics);
+void allocator_destroy(struct Graphics *graphics);
+
+int allocate_memory(struct Graphics *graphics,
+		    const VkMemoryRequirements *requirements,
+		    VkMemoryPropertyFlags properties, int kind,
+		    struct allocation *allocation);
+void free_memory(struct Graphics *graphics, struct allocation *allocation);
+
+int allocate_buffer_memory(struct Graphics *graphics, VkBuffer buffer,
+			   VkMemoryPropertyFlags properties,
+			   struct allocation *allocation);
+int allocate_image_memory(struct Graphics *graphics, VkImage image,
+			  VkMemoryPropertyFlags properties,
+			  struct allocation *allocation);
+
+void allocator_get_stats(const struct allocator *allocator,
+			 struct graphics_memory_stats *stats);
+
+#endif
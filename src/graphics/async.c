@@ -0,0 +1,280 @@
+#include <stdint.h>
+
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "async.h"
+#include "vksetup.h"
+
+static const int async_families[async_queues_n] = {
+	[async_transfer] = queue_families_transfer,
+	[async_compute] = queue_families_compute
+};
+
+static const char *const async_names[async_queues_n] = {
+	[async_transfer] = "transfer",
+	[async_compute] = "compute"
+};
+
+static int create_async_queue(struct Graphics *graphics, int role)
+{
+	struct async_queue *queue = graphics->async + role;
+	int family = async_families[role];
+
+	queue->family = graphics->queue_families.indices[family];
+	queue->queue = graphics->queues[family];
+
+	if(queue->family ==
+	   graphics->queue_families.indices[queue_families_graphics]) {
+		pdebug("%s queue: shares the graphics family", async_names[role]);
+		return 0;
+	}
+
+	pdebug("%s queue: dedicated family %u", async_names[role],
+	       queue->family);
+
+	VkCommandPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = queue->family
+	};
+
+	VkResult res = vkCreateCommandPool(graphics->device, &poolInfo, 0,
+					   &queue->commandpool);
+
+	if(res != VK_SUCCESS)
+		goto commandpool_create_error;
+
+	if(!timeline_enabled(&graphics->timeline))
+		return 0;
+
+	VkSemaphoreTypeCreateInfo typeInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0
+	};
+
+	VkSemaphoreCreateInfo semaphoreInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &typeInfo
+	};
+
+	res = vkCreateSemaphore(graphics->device, &semaphoreInfo, 0,
+				&queue->semaphore);
+
+	if(res != VK_SUCCESS)
+		goto semaphore_create_error;
+
+	return 0;
+
+semaphore_create_error:
+	vkDestroyCommandPool(graphics->device, queue->commandpool, 0);
+	queue->commandpool = VK_NULL_HANDLE;
+commandpool_create_error:
+	return -1;
+}
+
+static void destroy_async_queue(struct Graphics *graphics, int role)
+{
+	struct async_queue *queue = graphics->async + role;
+
+	vkDestroySemaphore(graphics->device, queue->semaphore, 0);
+	vkDestroyCommandPool(graphics->device, queue->commandpool, 0);
+
+	queue->semaphore = VK_NULL_HANDLE;
+	queue->commandpool = VK_NULL_HANDLE;
+}
+
+int create_async_queues(struct Graphics *graphics)
+{
+	int i;
+
+	for(i = 0; i < async_queues_n; i++) {
+		if(create_async_queue(graphics, i) == -1)
+			goto queue_create_error;
+	}
+
+	return 0;
+
+queue_create_error:
+	while(i--)
+		destroy_async_queue(graphics, i);
+
+	return -1;
+}
+
+void destroy_async_queues(struct Graphics *graphics)
+{
+	for(int i = 0; i < async_queues_n; i++)
+		destroy_async_queue(graphics, i);
+}
+
+VkCommandBuffer async_begin(struct Graphics *graphics, int role)
+{
+	struct async_queue *queue = graphics->async + role;
+	VkCommandBuffer commandbuffer;
+
+	VkCommandBufferAllocateInfo allocInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = queue->commandpool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1
+	};
+
+	VkResult res = vkAllocateCommandBuffers(graphics->device, &allocInfo,
+						&commandbuffer);
+
+	if(res != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	VkCommandBufferBeginInfo beginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+
+	res = vkBeginCommandBuffer(commandbuffer, &beginInfo);
+
+	if(res != VK_SUCCESS) {
+		vkFreeCommandBuffers(graphics->device, queue->commandpool, 1,
+				     &commandbuffer);
+		return VK_NULL_HANDLE;
+	}
+
+	return commandbuffer;
+}
+
+int async_submit(struct Graphics *graphics, int role,
+		 VkCommandBuffer commandbuffer)
+{
+	struct async_queue *queue = graphics->async + role;
+	uint64_t value = queue->submitted + 1;
+
+	VkResult res = vkEndCommandBuffer(commandbuffer);
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &value
+	};
+
+	VkSubmitInfo submitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &commandbuffer
+	};
+
+	if(queue->semaphore != VK_NULL_HANDLE) {
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &queue->semaphore;
+	}
+
+	if(res == VK_SUCCESS)
+		res = vkQueueSubmit(queue->queue, 1, &submitInfo,
+				    VK_NULL_HANDLE);
+
+	if(res != VK_SUCCESS)
+		return -1;
+
+	queue->submitted = value;
+
+	/* without a semaphore to wait on, the graphics queue needs it done */
+	if(queue->semaphore == VK_NULL_HANDLE &&
+	   vkQueueWaitIdle(queue->queue) != VK_SUCCESS)
+		return -1;
+
+	return 0;
+}
+
+int async_wait(struct Graphics *graphics, int role, uint64_t value)
+{
+	struct async_queue *queue = graphics->async + role;
+
+	/* the fallback drained the queue after submitting */
+	if(queue->semaphore == VK_NULL_HANDLE || !value)
+		return 0;
+
+	VkSemaphoreWaitInfo waitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &queue->semaphore,
+		.pValues = &value
+	};
+
+	VkResult res = vkWaitSemaphores(graphics->device, &waitInfo,
+					UINT64_MAX);
+
+	return res == VK_SUCCESS ? 0 : -1;
+}
+
+void async_frame_wait(struct Graphics *graphics, int role,
+		      VkPipelineStageFlags stages)
+{
+	struct async_queue *queue = graphics->async + role;
+
+	if(queue->semaphore == VK_NULL_HANDLE)
+		return;
+
+	queue->frame_wait = queue->submitted;
+	queue->frame_stages |= stages;
+}
+
+uint32_t async_frame_waits(struct Graphics *graphics, VkSemaphore *semaphores,
+			   uint64_t *values, VkPipelineStageFlags *stages)
+{
+	uint32_t waits_n = 0;
+
+	for(int i = 0; i < async_queues_n; i++) {
+		struct async_queue *queue = graphics->async + i;
+
+		if(!queue->frame_wait)
+			continue;
+
+		semaphores[waits_n] = queue->semaphore;
+		values[waits_n] = queue->frame_wait;
+		stages[waits_n++] = queue->frame_stages;
+
+		queue->frame_wait = 0;
+		queue->frame_stages = 0;
+	}
+
+	return waits_n;
+}
+
+void release_buffer(VkCommandBuffer commandbuffer, VkBuffer buffer,
+		    uint32_t src_family, uint32_t dst_family,
+		    VkPipelineStageFlags src_stages, VkAccessFlags src_access)
+{
+	VkBufferMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = src_access,
+		.srcQueueFamilyIndex = src_family,
+		.dstQueueFamilyIndex = dst_family,
+		.buffer = buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+
+	vkCmdPipelineBarrier(commandbuffer, src_stages,
+			     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0, 1,
+			     &barrier, 0, 0);
+}
+
+void acquire_buffer(VkCommandBuffer commandbuffer, VkBuffer buffer,
+		    uint32_t src_family, uint32_t dst_family,
+		    VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+{
+	VkBufferMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.dstAccessMask = dst_access,
+		.srcQueueFamilyIndex = src_family,
+		.dstQueueFamilyIndex = dst_family,
+		.buffer = buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+
+	/* the semaphore wait covers dst_stages, nothing earlier has to finish */
+	vkCmdPipelineBarrier(commandbuffer, dst_stages, dst_stages, 0, 0, 0, 1,
+			     &barrier, 0, 0);
+}
@@ -0,0 +1,76 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+struct Graphics;
+
+enum async_queues {
+	async_transfer,
+	async_compute,
+	async_queues_n
+};
+
+/*
+ * A queue of a dedicated transfer or async compute family, fed from its
+ * own command pool. Work on it runs next to rendering; the graphics queue
+ * only waits for it, through the queue's timeline semaphore, right before
+ * the commands that consume its results. Resources cross families with a
+ * release barrier recorded here and a matching acquire on the graphics
+ * queue. Roles without a dedicated family stay on the graphics queue.
+ */
+struct async_queue {
+	uint32_t family;
+	VkQueue queue;
+
+	/* VK_NULL_HANDLE when the role shares the graphics family */
+	VkCommandPool commandpool;
+
+	/* VK_NULL_HANDLE on the fence fallback, which drains the queue */
+	VkSemaphore semaphore;
+	uint64_t submitted;
+
+	/* value the next frame waits for before frame_stages, 0 for none */
+	uint64_t frame_wait;
+	VkPipelineStageFlags frame_stages;
+};
+
+int create_async_queues(struct Graphics *graphics);
+void destroy_async_queues(struct Graphics *graphics);
+
+static inline int async_dedicated(const struct async_queue *queue)
+{
+	return queue->commandpool != VK_NULL_HANDLE;
+}
+
+VkCommandBuffer async_begin(struct Graphics *graphics, int role);
+/* ends and submits commandbuffer, which signals the queue's next value */
+int async_submit(struct Graphics *graphics, int role,
+		 VkCommandBuffer commandbuffer);
+
+/* blocks until role's submission with value completed */
+int async_wait(struct Graphics *graphics, int role, uint64_t value);
+
+/* makes the next frame wait for role's last submission before stages */
+void async_frame_wait(struct Graphics *graphics, int role,
+		      VkPipelineStageFlags stages);
+/*
+ * moves the pending frame waits into the arrays, which hold
+ * async_queues_n entries each, and returns their count
+ */
+uint32_t async_frame_waits(struct Graphics *graphics, VkSemaphore *semaphores,
+			   uint64_t *values, VkPipelineStageFlags *stages);
+
+/*
+ * records the release half of a queue family ownership transfer on the
+ * source queue, or the acquire half on the destination queue
+ */
+void release_buffer(VkCommandBuffer commandbuffer, VkBuffer buffer,
+		    uint32_t src_family, uint32_t dst_family,
+		    VkPipelineStageFlags src_stages, VkAccessFlags src_access);
+void acquire_buffer(VkCommandBuffer commandbuffer, VkBuffer buffer,
+		    uint32_t src_family, uint32_t dst_family,
+		    VkPipelineStageFlags dst_stages, VkAccessFlags dst_access);
+
+#endif
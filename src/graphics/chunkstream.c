@@ -0,0 +1,821 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <graphics/chunkfile.h>
+#include <graphics/setup.h>
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "chunkstream.h"
+#include "vksetup.h"
+
+static inline VkDeviceSize align_chunk(VkDeviceSize offset)
+{
+	return (offset + CHUNKSTREAM_ALIGNMENT - 1) &
+	       ~(VkDeviceSize) (CHUNKSTREAM_ALIGNMENT - 1);
+}
+
+static inline VkDeviceSize vertices_bytes(const struct chunkfile_entry *entry)
+{
+	return (VkDeviceSize) entry->vertices_n * sizeof(struct graphics_vertex);
+}
+
+static inline VkDeviceSize chunk_bytes(const struct chunkfile_entry *entry)
+{
+	return vertices_bytes(entry) +
+	       (VkDeviceSize) entry->indices_n * sizeof(uint32_t);
+}
+
+/* the slot keeps the indices aligned behind the vertices */
+static inline VkDeviceSize slot_bytes(const struct chunkfile_entry *entry)
+{
+	return align_chunk(vertices_bytes(entry)) +
+	       (VkDeviceSize) entry->indices_n * sizeof(uint32_t);
+}
+
+/* the pool starts with an identity instance for the instance binding */
+static inline VkDeviceSize slot_offset(const struct chunkstream *chunkstream,
+				       uint32_t slot)
+{
+	return align_chunk(sizeof(struct graphics_instance)) +
+	       slot * chunkstream->slot_size;
+}
+
+static int is_visible(const struct chunkstream *chunkstream, uint32_t id)
+{
+	const struct chunkfile_entry *entry = chunkstream->entries + id;
+
+	return entry->max[0] >= chunkstream->view_min[0] &&
+	       entry->min[0] <= chunkstream->view_max[0] &&
+	       entry->max[1] >= chunkstream->view_min[1] &&
+	       entry->min[1] <= chunkstream->view_max[1];
+}
+
+static void push_chunk(struct chunkstream *chunkstream, uint32_t id)
+{
+	uint32_t tail = (chunkstream->queue_head + chunkstream->queue_n) %
+			chunkstream->chunks_n;
+
+	chunkstream->queue[tail] = id;
+	chunkstream->queue_n++;
+}
+
+static uint32_t pop_chunk(struct chunkstream *chunkstream)
+{
+	uint32_t id = chunkstream->queue[chunkstream->queue_head];
+
+	chunkstream->queue_head = (chunkstream->queue_head + 1) %
+				  chunkstream->chunks_n;
+	chunkstream->queue_n--;
+
+	return id;
+}
+
+/* a free slot, else the least recently drawn one no frame in flight reads */
+static uint32_t find_slot(struct chunkstream *chunkstream)
+{
+	uint32_t best = CHUNKSTREAM_NO_SLOT;
+	uint64_t best_used = UINT64_MAX;
+
+	for(uint32_t i = 0; i < chunkstream->slots_n; i++) {
+		uint32_t id = chunkstream->slot_chunks[i];
+
+		if(id == CHUNKSTREAM_NO_SLOT)
+			return i;
+
+		const struct chunk *chunk = chunkstream->chunks + id;
+
+		if(chunk->state != chunk_resident ||
+		   chunk->last_used > chunkstream->completed)
+			continue;
+
+		if(chunk->last_used < best_used) {
+			best_used = chunk->last_used;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+/* a staging slot whose last copy has completed */
+static uint32_t find_staging(const struct chunkstream *chunkstream)
+{
+	for(uint32_t i = 0; i < CHUNKSTREAM_STAGING_SLOTS; i++) {
+		if(chunkstream->staging_chunks[i] == CHUNKSTREAM_NO_SLOT &&
+		   chunkstream->staging_values[i] <= chunkstream->completed)
+			return i;
+	}
+
+	return CHUNKSTREAM_NO_SLOT;
+}
+
+static inline VkDeviceSize staging_offset(const struct chunkstream *chunkstream,
+					  uint32_t staging)
+{
+	return staging * chunkstream->slot_size;
+}
+
+/*
+ * reads the chunk from the file into its staging slot, -1 when an index
+ * points past its vertices and would read another slot's
+ */
+static int load_chunk(struct chunkstream *chunkstream, uint32_t id,
+		      uint32_t staging)
+{
+	const struct chunkfile_entry *entry = chunkstream->entries + id;
+	char *dst = (char *) chunkstream->staging_allocation.mapped +
+		    staging_offset(chunkstream, staging);
+	const char *src = (const char *) chunkstream->file.data + entry->offset;
+
+	filemap_prefetch(&chunkstream->file, entry->offset, chunk_bytes(entry));
+
+	memcpy(dst, src, vertices_bytes(entry));
+
+	/* checked on the way in, the staging memory may be slow to read back */
+	const char *src_indices = src + vertices_bytes(entry);
+	uint32_t *dst_indices =
+		(uint32_t *) (dst + align_chunk(vertices_bytes(entry)));
+
+	for(uint32_t i = 0; i < entry->indices_n; i++) {
+		uint32_t index;
+
+		memcpy(&index, src_indices + (size_t) i * sizeof(uint32_t),
+		       sizeof(uint32_t));
+
+		if(index >= entry->vertices_n)
+			return -1;
+
+		dst_indices[i] = index;
+	}
+
+	return 0;
+}
+
+static void *loader_main(void *arg)
+{
+	struct chunkstream *chunkstream = arg;
+
+	pthread_mutex_lock(&chunkstream->lock);
+
+	while(!chunkstream->quit) {
+		if(!chunkstream->queue_n) {
+			pthread_cond_wait(&chunkstream->wake, &chunkstream->lock);
+			continue;
+		}
+
+		uint32_t id = pop_chunk(chunkstream);
+		struct chunk *chunk = chunkstream->chunks + id;
+
+		/* scrolled out of view while it waited */
+		if(!is_visible(chunkstream, id)) {
+			chunk->state = chunk_absent;
+			continue;
+		}
+
+		/* nothing is evicted for a chunk that cannot be staged yet */
+		uint32_t staging = find_staging(chunkstream);
+		uint32_t slot = staging == CHUNKSTREAM_NO_SLOT ?
+					CHUNKSTREAM_NO_SLOT :
+					find_slot(chunkstream);
+
+		/* every slot is still used by frames in flight, retry next frame */
+		if(slot == CHUNKSTREAM_NO_SLOT) {
+			push_chunk(chunkstream, id);
+			pthread_cond_wait(&chunkstream->wake, &chunkstream->lock);
+			continue;
+		}
+
+		uint32_t evicted = chunkstream->slot_chunks[slot];
+
+		if(evicted != CHUNKSTREAM_NO_SLOT) {
+			chunkstream->chunks[evicted].state = chunk_absent;
+			chunkstream->chunks[evicted].slot = CHUNKSTREAM_NO_SLOT;
+			chunkstream->evictions++;
+		}
+
+		chunkstream->slot_chunks[slot] = id;
+		chunkstream->staging_chunks[staging] = id;
+		chunk->state = chunk_loading;
+		chunk->slot = slot;
+		chunk->staging = staging;
+
+		pthread_mutex_unlock(&chunkstream->lock);
+
+		int res = load_chunk(chunkstream, id, staging);
+
+		pthread_mutex_lock(&chunkstream->lock);
+
+		if(res == -1) {
+			pdebug("chunk %u has indices past its vertices, skipped", id);
+
+			chunkstream->slot_chunks[slot] = CHUNKSTREAM_NO_SLOT;
+			chunkstream->staging_chunks[staging] = CHUNKSTREAM_NO_SLOT;
+			chunk->state = chunk_invalid;
+			chunk->slot = CHUNKSTREAM_NO_SLOT;
+			continue;
+		}
+
+		chunk->state = chunk_staged;
+		chunkstream->loads++;
+	}
+
+	pthread_mutex_unlock(&chunkstream->lock);
+
+	return 0;
+}
+
+static int open_chunkfile(struct chunkstream *chunkstream, const char *path)
+{
+	if(filemap_open(path, &chunkstream->file, filemap_random) == -1)
+		return -1;
+
+	const struct filemap *file = &chunkstream->file;
+	const struct chunkfile_header *header = file->data;
+
+	if(file->size < sizeof(struct chunkfile_header) ||
+	   memcmp(header->magic, CHUNKFILE_MAGIC, 4) ||
+	   header->version != CHUNKFILE_VERSION ||
+	   header->vertex_size != sizeof(struct graphics_vertex) ||
+	   !header->chunks_n || header->table_offset > file->size ||
+	   header->table_offset % sizeof(uint64_t) ||
+	   (file->size - header->table_offset) /
+			   sizeof(struct chunkfile_entry) < header->chunks_n)
+		goto format_error;
+
+	chunkstream->entries = (const struct chunkfile_entry *)
+		((const char *) file->data + header->table_offset);
+	chunkstream->chunks_n = header->chunks_n;
+
+	for(uint32_t i = 0; i < chunkstream->chunks_n; i++) {
+		const struct chunkfile_entry *entry = chunkstream->entries + i;
+
+		if(entry->offset > file->size ||
+		   chunk_bytes(entry) > file->size - entry->offset)
+			goto format_error;
+
+		if(slot_bytes(entry) > chunkstream->slot_size)
+			chunkstream->slot_size = slot_bytes(entry);
+	}
+
+	chunkstream->slot_size = align_chunk(chunkstream->slot_size);
+
+	return 0;
+
+format_error:
+	pdebug("%s is not a valid chunk file", path);
+	filemap_close(&chunkstream->file);
+
+	return -1;
+}
+
+static int create_pool(struct Graphics *graphics,
+		       struct chunkstream *chunkstream)
+{
+	static const struct graphics_instance identity = {
+		.offset = {0, 0},
+		.scale = 1,
+		.color = {1, 1, 1}
+	};
+
+	int res = create_buffer(graphics,
+				slot_offset(chunkstream, chunkstream->slots_n),
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+					VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+					VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&chunkstream->buffer, &chunkstream->allocation);
+
+	if(res == -1)
+		goto pool_error;
+
+	if(upload_buffer(graphics, chunkstream->buffer, &identity,
+			 sizeof(identity)) == -1)
+		goto identity_error;
+
+	res = create_buffer(graphics,
+			    staging_offset(chunkstream, CHUNKSTREAM_STAGING_SLOTS),
+			    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			    &chunkstream->staging,
+			    &chunkstream->staging_allocation);
+
+	if(res == -1)
+		goto identity_error;
+
+	memset(chunkstream->staging_chunks, 0xff,
+	       sizeof(chunkstream->staging_chunks));
+
+	return 0;
+
+identity_error:
+	/* the identity's upload may still be in flight */
+	vkDeviceWaitIdle(graphics->device);
+	timeline_collect(graphics, 1);
+	destroy_buffer(graphics, chunkstream->buffer, &chunkstream->allocation);
+pool_error:
+	return -1;
+}
+
+static void destroy_pool(struct Graphics *graphics,
+			 struct chunkstream *chunkstream)
+{
+	destroy_buffer(graphics, chunkstream->staging,
+		       &chunkstream->staging_allocation);
+	destroy_buffer(graphics, chunkstream->buffer, &chunkstream->allocation);
+}
+
+/* the handover needs a semaphore, the fence fallback copies inline */
+static int create_upload_commandbuffers(struct Graphics *graphics,
+					struct chunkstream *chunkstream)
+{
+	struct async_queue *transfer = graphics->async + async_transfer;
+
+	chunkstream->async = async_dedicated(transfer) &&
+			     transfer->semaphore != VK_NULL_HANDLE;
+
+	if(!chunkstream->async)
+		return 0;
+
+	chunkstream->commandbuffers =
+		malloc(sizeof(VkCommandBuffer) * graphics->frames_inflight);
+	chunkstream->upload_values =
+		calloc(graphics->frames_inflight, sizeof(uint64_t));
+
+	if(!chunkstream->commandbuffers || !chunkstream->upload_values)
+		goto commandbuffers_error;
+
+	VkCommandBufferAllocateInfo allocInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = transfer->commandpool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = graphics->frames_inflight
+	};
+
+	VkResult res = vkAllocateCommandBuffers(graphics->device, &allocInfo,
+						chunkstream->commandbuffers);
+
+	if(res != VK_SUCCESS)
+		goto commandbuffers_error;
+
+	return 0;
+
+commandbuffers_error:
+	free(chunkstream->upload_values);
+	free(chunkstream->commandbuffers);
+
+	return -1;
+}
+
+static void destroy_upload_commandbuffers(struct Graphics *graphics,
+					  struct chunkstream *chunkstream)
+{
+	if(!chunkstream->async)
+		return;
+
+	vkFreeCommandBuffers(graphics->device,
+			     graphics->async[async_transfer].commandpool,
+			     graphics->frames_inflight,
+			     chunkstream->commandbuffers);
+
+	free(chunkstream->upload_values);
+	free(chunkstream->commandbuffers);
+}
+
+struct chunkstream *chunkstream_new(struct Graphics *graphics,
+				    const char *path, uint64_t budget)
+{
+	struct chunkstream *chunkstream = calloc(1, sizeof(struct chunkstream));
+
+	if(!chunkstream)
+		goto chunkstream_malloc_error;
+
+	if(open_chunkfile(chunkstream, path) == -1)
+		goto file_error;
+
+	VkDeviceSize pool_base = slot_offset(chunkstream, 0);
+
+	if(budget <= pool_base ||
+	   (budget - pool_base) / chunkstream->slot_size == 0) {
+		pdebug("chunk budget below one chunk of %llu bytes",
+		       (unsigned long long) chunkstream->slot_size);
+		goto budget_error;
+	}
+
+	uint64_t slots_n = (budget - pool_base) / chunkstream->slot_size;
+
+	chunkstream->slots_n = slots_n < chunkstream->chunks_n ?
+				       slots_n : chunkstream->chunks_n;
+
+	chunkstream->chunks = calloc(chunkstream->chunks_n, sizeof(struct chunk));
+	chunkstream->queue = malloc(sizeof(uint32_t) * chunkstream->chunks_n);
+	chunkstream->draws = malloc(sizeof(uint32_t) * chunkstream->chunks_n);
+	chunkstream->slot_chunks = malloc(sizeof(uint32_t) * chunkstream->slots_n);
+
+	if(!chunkstream->chunks || !chunkstream->queue || !chunkstream->draws ||
+	   !chunkstream->slot_chunks)
+		goto arrays_malloc_error;
+
+	memset(chunkstream->slot_chunks, 0xff,
+	       sizeof(uint32_t) * chunkstream->slots_n);
+
+	for(uint32_t i = 0; i < chunkstream->chunks_n; i++)
+		chunkstream->chunks[i].slot = CHUNKSTREAM_NO_SLOT;
+
+	if(create_pool(graphics, chunkstream) == -1)
+		goto pool_error;
+
+	if(create_upload_commandbuffers(graphics, chunkstream) == -1)
+		goto commandbuffers_error;
+
+	/* everything is visible until a view is set */
+	chunkstream->view_min[0] = chunkstream->view_min[1] = -1e30f;
+	chunkstream->view_max[0] = chunkstream->view_max[1] = 1e30f;
+
+	pthread_mutex_init(&chunkstream->lock, 0);
+	pthread_cond_init(&chunkstream->wake, 0);
+
+	if(pthread_create(&chunkstream->thread, 0, loader_main, chunkstream))
+		goto thread_create_error;
+
+	pdebug("chunks: %u chunks, %u slots of %llu bytes, copied on the %s queue",
+	       chunkstream->chunks_n, chunkstream->slots_n,
+	       (unsigned long long) chunkstream->slot_size,
+	       chunkstream->async ? "transfer" : "graphics");
+
+	return chunkstream;
+
+thread_create_error:
+	pthread_cond_destroy(&chunkstream->wake);
+	pthread_mutex_destroy(&chunkstream->lock);
+	destroy_upload_commandbuffers(graphics, chunkstream);
+commandbuffers_error:
+	/* the identity's upload may still be in flight */
+	vkDeviceWaitIdle(graphics->device);
+	destroy_pool(graphics, chunkstream);
+pool_error:
+arrays_malloc_error:
+	free(chunkstream->slot_chunks);
+	free(chunkstream->draws);
+	free(chunkstream->queue);
+	free(chunkstream->chunks);
+budget_error:
+	filemap_close(&chunkstream->file);
+file_error:
+	free(chunkstream);
+chunkstream_malloc_error:
+	return 0;
+}
+
+void chunkstream_delete(struct Graphics *graphics,
+			struct chunkstream *chunkstream)
+{
+	pthread_mutex_lock(&chunkstream->lock);
+	chunkstream->quit = 1;
+	pthread_cond_signal(&chunkstream->wake);
+	pthread_mutex_unlock(&chunkstream->lock);
+
+	pthread_join(chunkstream->thread, 0);
+
+	pthread_cond_destroy(&chunkstream->wake);
+	pthread_mutex_destroy(&chunkstream->lock);
+
+	destroy_upload_commandbuffers(graphics, chunkstream);
+	destroy_pool(graphics, chunkstream);
+
+	free(chunkstream->slot_chunks);
+	free(chunkstream->draws);
+	free(chunkstream->queue);
+	free(chunkstream->chunks);
+
+	filemap_close(&chunkstream->file);
+	free(chunkstream);
+}
+
+static void record_copies(struct chunkstream *chunkstream,
+			  VkCommandBuffer commandbuffer, const uint32_t *ids,
+			  uint32_t ids_n)
+{
+	VkBufferCopy regions[CHUNKSTREAM_STAGING_SLOTS];
+
+	for(uint32_t i = 0; i < ids_n; i++) {
+		const struct chunk *chunk = chunkstream->chunks + ids[i];
+
+		regions[i] = (VkBufferCopy) {
+			.srcOffset = staging_offset(chunkstream, chunk->staging),
+			.dstOffset = slot_offset(chunkstream, chunk->slot),
+			.size = slot_bytes(chunkstream->entries + ids[i])
+		};
+	}
+
+	vkCmdCopyBuffer(commandbuffer, chunkstream->staging, chunkstream->buffer,
+			ids_n, regions);
+}
+
+/* one barrier per slot written, the rest of the pool stays untouched */
+static void record_upload_barriers(struct chunkstream *chunkstream,
+				   VkCommandBuffer commandbuffer,
+				   const uint32_t *ids, uint32_t ids_n,
+				   uint32_t src_family, uint32_t dst_family,
+				   VkPipelineStageFlags src_stages,
+				   VkAccessFlags src_access,
+				   VkPipelineStageFlags dst_stages,
+				   VkAccessFlags dst_access)
+{
+	VkBufferMemoryBarrier barriers[CHUNKSTREAM_STAGING_SLOTS];
+
+	for(uint32_t i = 0; i < ids_n; i++) {
+		const struct chunk *chunk = chunkstream->chunks + ids[i];
+
+		barriers[i] = (VkBufferMemoryBarrier) {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = src_access,
+			.dstAccessMask = dst_access,
+			.srcQueueFamilyIndex = src_family,
+			.dstQueueFamilyIndex = dst_family,
+			.buffer = chunkstream->buffer,
+			.offset = slot_offset(chunkstream, chunk->slot),
+			.size = slot_bytes(chunkstream->entries + ids[i])
+		};
+	}
+
+	vkCmdPipelineBarrier(commandbuffer, src_stages, dst_stages, 0, 0, 0,
+			     ids_n, barriers, 0, 0);
+}
+
+/*
+ * The slots were last drawn by frames that completed before the loader
+ * picked them, so the copies need no dependency on rendering
+ */
+static int submit_uploads(struct Graphics *graphics, const uint32_t *ids,
+			  uint32_t ids_n)
+{
+	struct chunkstream *chunkstream = graphics->chunkstream;
+	struct async_queue *transfer = graphics->async + async_transfer;
+	uint32_t slot = graphics->current_frame;
+	VkCommandBuffer commandbuffer = chunkstream->commandbuffers[slot];
+
+	/* done unless the frame that waited for it failed to submit */
+	if(async_wait(graphics, async_transfer,
+		      chunkstream->upload_values[slot]) == -1)
+		return -1;
+
+	VkCommandBufferBeginInfo beginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+
+	if(vkBeginCommandBuffer(commandbuffer, &beginInfo) != VK_SUCCESS)
+		return -1;
+
+	record_copies(chunkstream, commandbuffer, ids, ids_n);
+
+	record_upload_barriers(chunkstream, commandbuffer, ids, ids_n,
+			       transfer->family,
+			       graphics->queue_families.indices[queue_families_graphics],
+			       VK_PIPELINE_STAGE_TRANSFER_BIT,
+			       VK_ACCESS_TRANSFER_WRITE_BIT,
+			       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+
+	if(async_submit(graphics, async_transfer, commandbuffer) == -1)
+		return -1;
+
+	chunkstream->upload_values[slot] = transfer->submitted;
+
+	async_frame_wait(graphics, async_transfer,
+			 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+
+	return 0;
+}
+
+int chunkstream_prepare(struct Graphics *graphics)
+{
+	struct chunkstream *chunkstream = graphics->chunkstream;
+	/* the timeline value this frame's submission will signal */
+	uint64_t frame = timeline_next(&graphics->timeline);
+	uint64_t completed = timeline_completed(graphics);
+	uint32_t copies[CHUNKSTREAM_STAGING_SLOTS];
+	uint32_t copies_n = 0;
+	int queued = 0;
+
+	pthread_mutex_lock(&chunkstream->lock);
+
+	chunkstream->completed = completed;
+
+	chunkstream->draws_n = 0;
+	chunkstream->uploads_n = 0;
+
+	/*
+	 * this frame copies them in, so it may already draw them; they only
+	 * become resident once it is submitted, a frame that fails leaves
+	 * them to the next one
+	 */
+	for(uint32_t i = 0; i < CHUNKSTREAM_STAGING_SLOTS; i++) {
+		uint32_t id = chunkstream->staging_chunks[i];
+
+		if(id == CHUNKSTREAM_NO_SLOT)
+			continue;
+
+		int state = chunkstream->chunks[id].state;
+
+		if(state != chunk_staged && state != chunk_uploading)
+			continue;
+
+		/* an earlier failed frame already submitted its copy */
+		if(state == chunk_staged && chunkstream->async)
+			copies[copies_n++] = id;
+
+		chunkstream->uploads[chunkstream->uploads_n++] = id;
+
+		if(is_visible(chunkstream, id))
+			chunkstream->draws[chunkstream->draws_n++] = id;
+	}
+
+	for(uint32_t i = 0; i < chunkstream->chunks_n; i++) {
+		struct chunk *chunk = chunkstream->chunks + i;
+
+		if(!is_visible(chunkstream, i))
+			continue;
+
+		if(chunk->state == chunk_resident) {
+			chunk->last_used = frame;
+			chunkstream->draws[chunkstream->draws_n++] = i;
+		} else if(chunk->state == chunk_absent) {
+			chunk->state = chunk_queued;
+			push_chunk(chunkstream, i);
+			queued = 1;
+		}
+	}
+
+	/* also wakes a loader waiting for slots to retire */
+	if(queued || chunkstream->queue_n)
+		pthread_cond_signal(&chunkstream->wake);
+
+	pthread_mutex_unlock(&chunkstream->lock);
+
+	if(!copies_n)
+		return 0;
+
+	if(submit_uploads(graphics, copies, copies_n) == -1)
+		return -1;
+
+	pthread_mutex_lock(&chunkstream->lock);
+
+	for(uint32_t i = 0; i < copies_n; i++)
+		chunkstream->chunks[copies[i]].state = chunk_uploading;
+
+	pthread_mutex_unlock(&chunkstream->lock);
+
+	return 0;
+}
+
+void chunkstream_submitted(struct Graphics *graphics, uint64_t value)
+{
+	struct chunkstream *chunkstream = graphics->chunkstream;
+
+	pthread_mutex_lock(&chunkstream->lock);
+
+	for(uint32_t i = 0; i < chunkstream->uploads_n; i++) {
+		struct chunk *chunk = chunkstream->chunks + chunkstream->uploads[i];
+
+		chunk->state = chunk_resident;
+		chunk->last_used = value;
+		chunkstream->staging_chunks[chunk->staging] = CHUNKSTREAM_NO_SLOT;
+		chunkstream->staging_values[chunk->staging] = value;
+	}
+
+	chunkstream->uploads_n = 0;
+
+	pthread_mutex_unlock(&chunkstream->lock);
+}
+
+void record_chunk_uploads(struct Graphics *graphics,
+			  VkCommandBuffer commandbuffer)
+{
+	struct chunkstream *chunkstream = graphics->chunkstream;
+
+	if(!chunkstream->uploads_n)
+		return;
+
+	/* the semaphore wait covers vertex input, nothing earlier has to finish */
+	if(chunkstream->async) {
+		record_upload_barriers(chunkstream, commandbuffer,
+				       chunkstream->uploads,
+				       chunkstream->uploads_n,
+				       graphics->async[async_transfer].family,
+				       graphics->queue_families.indices[queue_families_graphics],
+				       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+				       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				       VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+					       VK_ACCESS_INDEX_READ_BIT);
+		return;
+	}
+
+	record_copies(chunkstream, commandbuffer, chunkstream->uploads,
+		      chunkstream->uploads_n);
+
+	record_upload_barriers(chunkstream, commandbuffer, chunkstream->uploads,
+			       chunkstream->uploads_n, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			       VK_PIPELINE_STAGE_TRANSFER_BIT,
+			       VK_ACCESS_TRANSFER_WRITE_BIT,
+			       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			       VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+				       VK_ACCESS_INDEX_READ_BIT);
+}
+
+void record_chunks(struct Graphics *graphics, VkCommandBuffer commandbuffer)
+{
+	struct chunkstream *chunkstream = graphics->chunkstream;
+
+	VkBuffer buffers[vertex_bindings_n] = {
+		[vertex_binding_vertex] = chunkstream->buffer,
+		[vertex_binding_instance] = chunkstream->buffer
+	};
+
+	VkDeviceSize offsets[vertex_bindings_n] = {
+		[vertex_binding_instance] = 0
+	};
+
+	/* captured under the lock, the loader cannot evict them this frame */
+	for(uint32_t i = 0; i < chunkstream->draws_n; i++) {
+		uint32_t id = chunkstream->draws[i];
+		const struct chunkfile_entry *entry = chunkstream->entries + id;
+		VkDeviceSize offset =
+			slot_offset(chunkstream, chunkstream->chunks[id].slot);
+
+		offsets[vertex_binding_vertex] = offset;
+
+		vkCmdBindVertexBuffers(commandbuffer, 0, vertex_bindings_n,
+				       buffers, offsets);
+		vkCmdBindIndexBuffer(commandbuffer, chunkstream->buffer,
+				     offset + align_chunk(vertices_bytes(entry)),
+				     VK_INDEX_TYPE_UINT32);
+		vkCmdDrawIndexed(commandbuffer, entry->indices_n, 1, 0, 0, 0);
+	}
+}
+
+int graphics_load_chunks(struct Graphics *graphics, const char *path,
+			 uint64_t budget)
+{
+	graphics_unload_chunks(graphics);
+
+	graphics->chunkstream = chunkstream_new(graphics, path, budget);
+
+	return graphics->chunkstream ? 0 : -1;
+}
+
+void graphics_unload_chunks(struct Graphics *graphics)
+{
+	if(!graphics->chunkstream)
+		return;
+
+	/* recorded frames may still read the pool */
+	vkDeviceWaitIdle(graphics->device);
+
+	chunkstream_delete(graphics, graphics->chunkstream);
+	graphics->chunkstream = 0;
+}
+
+void graphics_set_chunk_view(struct Graphics *graphics, const float min[2],
+			     const float max[2])
+{
+	struct chunkstream *chunkstream = graphics->chunkstream;
+
+	if(!chunkstream)
+		return;
+
+	pthread_mutex_lock(&chunkstream->lock);
+
+	memcpy(chunkstream->view_min, min, sizeof(chunkstream->view_min));
+	memcpy(chunkstream->view_max, max, sizeof(chunkstream->view_max));
+
+	pthread_mutex_unlock(&chunkstream->lock);
+}
+
+void graphics_get_chunk_stats(const struct Graphics *graphics,
+			      struct graphics_chunk_stats *stats)
+{
+	struct chunkstream *chunkstream = graphics->chunkstream;
+
+	memset(stats, 0, sizeof(struct graphics_chunk_stats));
+
+	if(!chunkstream)
+		return;
+
+	pthread_mutex_lock(&chunkstream->lock);
+
+	stats->chunks_n = chunkstream->chunks_n;
+	stats->slots_n = chunkstream->slots_n;
+	stats->drawn_n = chunkstream->draws_n;
+	stats->queued_n = chunkstream->queue_n;
+	stats->loads = chunkstream->loads;
+	stats->evictions = chunkstream->evictions;
+
+	for(uint32_t i = 0; i < chunkstream->slots_n; i++)
+		stats->resident_n += chunkstream->slot_chunks[i] != CHUNKSTREAM_NO_SLOT;
+
+	pthread_mutex_unlock(&chunkstream->lock);
+}
@@ -0,0 +1,125 @@
+#ifndef CHUNKSTREAM_H
+#define CHUNKSTREAM_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include <graphics/chunkfile.h>
+
+#include "allocator.h"
+#include "filemap.h"
+
+struct Graphics;
+
+#define CHUNKSTREAM_ALIGNMENT 64
+#define CHUNKSTREAM_NO_SLOT UINT32_MAX
+/* chunks the loader can have read ahead of the frames copying them */
+#define CHUNKSTREAM_STAGING_SLOTS 8
+
+enum chunk_states {
+	chunk_absent,
+	chunk_queued,
+	chunk_loading,
+	/* read into staging, copied into its slot by the next frame */
+	chunk_staged,
+	/* its transfer queue copy was submitted, the frame was not yet */
+	chunk_uploading,
+	chunk_resident,
+	/* indices past its vertices, never loaded */
+	chunk_invalid
+};
+
+struct chunk {
+	int state;
+	uint32_t slot;
+	/* staging slot while loading or staged */
+	uint32_t staging;
+	/* timeline value of the last frame that drew the chunk */
+	uint64_t last_used;
+};
+
+/*
+ * Streams chunks of a mapped chunk file into a fixed pool of equally
+ * sized slots, one device local buffer sized by the memory budget. The
+ * render thread queues visible chunks that are not resident, a loader
+ * thread reads them from the file into a small host visible staging ring
+ * and picks their slots, evicting the least recently drawn chunk once no
+ * frame in flight can still read it. The next frame copies the staged
+ * chunks into their slots: on the dedicated transfer queue, handed over
+ * to the graphics family like the particle positions, or otherwise in
+ * front of its render pass.
+ */
+struct chunkstream {
+	struct filemap file;
+	const struct chunkfile_entry *entries;
+
+	uint32_t chunks_n;
+	struct chunk *chunks;
+
+	VkBuffer buffer;
+	struct allocation allocation;
+
+	VkDeviceSize slot_size;
+	uint32_t slots_n;
+	uint32_t *slot_chunks;
+
+	/* CHUNKSTREAM_STAGING_SLOTS slots laid out like the pool's */
+	VkBuffer staging;
+	struct allocation staging_allocation;
+	/* chunk in each staging slot, CHUNKSTREAM_NO_SLOT when free */
+	uint32_t staging_chunks[CHUNKSTREAM_STAGING_SLOTS];
+	/* timeline value of the frame that last copied out of each */
+	uint64_t staging_values[CHUNKSTREAM_STAGING_SLOTS];
+
+	/* staged chunks the frame being recorded copies in and draws */
+	uint32_t uploads_n;
+	uint32_t uploads[CHUNKSTREAM_STAGING_SLOTS];
+
+	/* copies go through the transfer queue, one command buffer per slot */
+	int async;
+	VkCommandBuffer *commandbuffers;
+	uint64_t *upload_values;
+
+	/* pending loads, a ring that can hold every chunk once */
+	uint32_t *queue;
+	uint32_t queue_head;
+	uint32_t queue_n;
+
+	float view_min[2];
+	float view_max[2];
+
+	/* submissions up to this timeline value have finished on the GPU */
+	uint64_t completed;
+
+	uint64_t loads;
+	uint64_t evictions;
+
+	/* resident visible chunks captured for the frame being recorded */
+	uint32_t draws_n;
+	uint32_t *draws;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	int quit;
+};
+
+struct chunkstream *chunkstream_new(struct Graphics *graphics,
+				    const char *path, uint64_t budget);
+void chunkstream_delete(struct Graphics *graphics,
+			struct chunkstream *chunkstream);
+
+/*
+ * queues newly visible chunks, captures the drawable ones and submits the
+ * staged chunks' copies when they go through the transfer queue
+ */
+int chunkstream_prepare(struct Graphics *graphics);
+/* the frame that copied the staged chunks in was submitted with value */
+void chunkstream_submitted(struct Graphics *graphics, uint64_t value);
+/* the staged chunks' copies, or their acquire, in front of the render pass */
+void record_chunk_uploads(struct Graphics *graphics,
+			  VkCommandBuffer commandbuffer);
+void record_chunks(struct Graphics *graphics, VkCommandBuffer commandbuffer);
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "compute.h"
+#include "vksetup.h"
+
+#define COMPUTE_BUFFERS_MAX 8
+
+static int create_set_layout(struct Graphics *graphics, uint32_t buffers_n,
+			     VkDescriptorSetLayout *set_layout)
+{
+	VkDescriptorSetLayoutBinding bindings[COMPUTE_BUFFERS_MAX];
+
+	if(buffers_n > COMPUTE_BUFFERS_MAX)
+		return -1;
+
+	for(uint32_t i = 0; i < buffers_n; i++) {
+		bindings[i] = (VkDescriptorSetLayoutBinding) {
+			.binding = i,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+		};
+	}
+
+	/* owned by the layout cache */
+	*set_layout = descriptor_layout(graphics, bindings, 0, buffers_n);
+
+	return *set_layout == VK_NULL_HANDLE ? -1 : 0;
+}
+
+int create_compute_pipeline(struct Graphics *graphics, const uint32_t *code,
+			    size_t size, uint32_t buffers_n, uint32_t push_size,
+			    struct compute_pipeline *pipeline)
+{
+	VkShaderModuleCreateInfo moduleInfo = {
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = size,
+		.pCode = code
+	};
+
+	VkResult res = vkCreateShaderModule(graphics->device, &moduleInfo, 0,
+					    &pipeline->module);
+
+	if(res != VK_SUCCESS)
+		goto module_create_error;
+
+	if(create_set_layout(graphics, buffers_n, &pipeline->set_layout) == -1)
+		goto set_layout_create_error;
+
+	VkPushConstantRange pushRange = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = push_size
+	};
+
+	VkPipelineLayoutCreateInfo layoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &pipeline->set_layout,
+		.pushConstantRangeCount = push_size ? 1 : 0,
+		.pPushConstantRanges = &pushRange
+	};
+
+	res = vkCreatePipelineLayout(graphics->device, &layoutInfo, 0,
+				     &pipeline->layout);
+
+	if(res != VK_SUCCESS)
+		goto layout_create_error;
+
+	VkComputePipelineCreateInfo pipelineInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = pipeline->module,
+			.pName = "main"
+		},
+		.layout = pipeline->layout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+
+	res = vkCreateComputePipelines(graphics->device,
+				       graphics->pipelinecache, 1,
+				       &pipelineInfo, 0, &pipeline->pipeline);
+
+	if(res != VK_SUCCESS)
+		goto pipeline_create_error;
+
+	pipeline->push_size = push_size;
+
+	return 0;
+
+pipeline_create_error:
+	vkDestroyPipelineLayout(graphics->device, pipeline->layout, 0);
+layout_create_error:
+set_layout_create_error:
+	vkDestroyShaderModule(graphics->device, pipeline->module, 0);
+module_create_error:
+	return -1;
+}
+
+void destroy_compute_pipeline(struct Graphics *graphics,
+			      struct compute_pipeline *pipeline)
+{
+	vkDestroyPipeline(graphics->device, pipeline->pipeline, 0);
+	vkDestroyPipelineLayout(graphics->device, pipeline->layout, 0);
+	vkDestroyShaderModule(graphics->device, pipeline->module, 0);
+}
+
+void record_dispatch(VkCommandBuffer commandbuffer,
+		     const struct compute_pipeline *pipeline,
+		     VkDescriptorSet set, const void *push,
+		     uint32_t invocations_n, uint32_t group_size)
+{
+	vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+			  pipeline->pipeline);
+	vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+				pipeline->layout, 0, 1, &set, 0, 0);
+
+	if(pipeline->push_size)
+		vkCmdPushConstants(commandbuffer, pipeline->layout,
+				   VK_SHADER_STAGE_COMPUTE_BIT, 0,
+				   pipeline->push_size, push);
+
+	vkCmdDispatch(commandbuffer,
+		      (invocations_n + group_size - 1) / group_size, 1, 1);
+}
@@ -0,0 +1,35 @@
+#ifndef COMPUTE_H
+#define COMPUTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+struct Graphics;
+
+/*
+ * A compute shader with its layout: storage buffers at bindings
+ * [0, buffers_n) of set 0 and push_size bytes of push constants.
+ */
+struct compute_pipeline {
+	VkShaderModule module;
+	/* owned by the layout cache */
+	VkDescriptorSetLayout set_layout;
+	VkPipelineLayout layout;
+	VkPipeline pipeline;
+	uint32_t push_size;
+};
+
+int create_compute_pipeline(struct Graphics *graphics, const uint32_t *code,
+			    size_t size, uint32_t buffers_n, uint32_t push_size,
+			    struct compute_pipeline *pipeline);
+void destroy_compute_pipeline(struct Graphics *graphics,
+			      struct compute_pipeline *pipeline);
+
+/* enough groups of group_size invocations to cover invocations_n */
+void record_dispatch(VkCommandBuffer commandbuffer,
+		     const struct compute_pipeline *pipeline,
+		     VkDescriptorSet set, const void *push,
+		     uint32_t invocations_n, uint32_t group_size);
+
+#endif
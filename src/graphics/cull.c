@@ -0,0 +1,301 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <graphics/setup.h>
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "cull.h"
+#include "shaders.h"
+#include "vksetup.h"
+
+enum cull_bindings {
+	cull_binding_instances,
+	cull_binding_draws,
+	cull_bindings_n
+};
+
+_Static_assert(sizeof(struct graphics_instance) == sizeof(float) * 7,
+	       "cull.comp reads instances as 7 floats");
+
+/* the camera's view edges in world space, normals pointing inside */
+static void view_planes(const struct Graphics *graphics, float planes[4][4])
+{
+	const struct camera_uniform *camera = &graphics->uniforms.camera;
+
+	for(int axis = 0; axis < 2; axis++) {
+		float extent = 1 / fabsf(camera->scale[axis]);
+		float *low = planes[axis * 2];
+		float *high = planes[axis * 2 + 1];
+
+		memset(low, 0, sizeof(float) * 4);
+		memset(high, 0, sizeof(float) * 4);
+
+		low[axis] = 1;
+		low[3] = extent - camera->center[axis];
+		high[axis] = -1;
+		high[3] = extent + camera->center[axis];
+	}
+}
+
+static void destroy_draw_buffers(struct Graphics *graphics, struct cull *cull,
+				 uint32_t slots_n)
+{
+	for(uint32_t i = 0; i < slots_n; i++)
+		destroy_buffer(graphics, cull->draws[i],
+			       cull->draw_allocations + i);
+}
+
+static int create_draw_buffers(struct Graphics *graphics, struct cull *cull,
+			       uint32_t capacity)
+{
+	/* an empty scene still gets buffers, a capacity of 0 means none */
+	if(!capacity)
+		capacity = 1;
+
+	VkDeviceSize size = CULL_DRAWS_OFFSET +
+			    (VkDeviceSize) capacity *
+				    sizeof(VkDrawIndexedIndirectCommand);
+	uint32_t i;
+
+	for(i = 0; i < graphics->frames_inflight; i++) {
+		int res = create_buffer(graphics, size,
+					VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+						VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+						VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+					cull->draws + i,
+					cull->draw_allocations + i);
+
+		if(res == -1)
+			goto draws_create_error;
+	}
+
+	cull->capacity = capacity;
+
+	return 0;
+
+draws_create_error:
+	destroy_draw_buffers(graphics, cull, i);
+	cull->capacity = 0;
+
+	return -1;
+}
+
+static void free_cull(struct cull *cull)
+{
+	free(cull->draw_allocations);
+	free(cull->draws);
+	free(cull);
+}
+
+static int create_cull(struct Graphics *graphics)
+{
+	uint32_t slots_n = graphics->frames_inflight;
+
+	struct cull *cull = calloc(1, sizeof(struct cull));
+
+	if(!cull)
+		goto cull_malloc_error;
+
+	cull->draws = malloc(sizeof(VkBuffer) * slots_n);
+	cull->draw_allocations = malloc(sizeof(struct allocation) * slots_n);
+
+	if(!cull->draws || !cull->draw_allocations)
+		goto arrays_malloc_error;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(graphics->physicalDevice, &properties);
+
+	cull->max_draws = properties.limits.maxDrawIndirectCount;
+
+	if(create_compute_pipeline(graphics, cull_comp_spv, cull_comp_spv_size,
+				   cull_bindings_n, sizeof(struct cull_params),
+				   &cull->compute) == -1)
+		goto compute_error;
+
+	if(create_draw_buffers(graphics, cull, graphics->instances_n) == -1)
+		goto draws_error;
+
+	graphics->cull = cull;
+
+	return 0;
+
+draws_error:
+	destroy_compute_pipeline(graphics, &cull->compute);
+compute_error:
+arrays_malloc_error:
+	free_cull(cull);
+cull_malloc_error:
+	return -1;
+}
+
+void destroy_cull(struct Graphics *graphics)
+{
+	struct cull *cull = graphics->cull;
+
+	if(!cull)
+		return;
+
+	if(cull->capacity)
+		destroy_draw_buffers(graphics, cull, graphics->frames_inflight);
+
+	destroy_compute_pipeline(graphics, &cull->compute);
+	free_cull(cull);
+
+	graphics->cull = 0;
+}
+
+int graphics_set_gpu_culling(Graphics *graphics, int enable)
+{
+	if(enable && !(graphics->flags & graphics_indirect_flag))
+		return -1;
+
+	if(!enable == !graphics->cull)
+		return 0;
+
+	if(enable)
+		return create_cull(graphics);
+
+	vkDeviceWaitIdle(graphics->device);
+	destroy_cull(graphics);
+
+	return 0;
+}
+
+int cull_active(const struct Graphics *graphics)
+{
+	return graphics->cull &&
+	       !(graphics->flags & graphics_cached_commands_flag) &&
+	       graphics->instances_n <= graphics->cull->max_draws;
+}
+
+int cull_prepare(struct Graphics *graphics)
+{
+	struct cull *cull = graphics->cull;
+
+	cull->slot = graphics->current_frame;
+
+	if(graphics->instances_n > cull->capacity || !cull->capacity) {
+		uint32_t capacity = cull->capacity * 2;
+
+		if(capacity < graphics->instances_n)
+			capacity = graphics->instances_n;
+
+		/* rare, so simply drains the GPU instead of retiring them */
+		vkDeviceWaitIdle(graphics->device);
+
+		if(cull->capacity)
+			destroy_draw_buffers(graphics, cull,
+					     graphics->frames_inflight);
+
+		cull->capacity = 0;
+
+		/* leaves the capacity at 0, the next frame tries again */
+		if(create_draw_buffers(graphics, cull, capacity) == -1)
+			return -1;
+
+		pdebug("cull draw buffers grown to %u draws", capacity);
+	}
+
+	/* both buffers can be replaced between frames, so the set is per frame */
+	struct descriptor_buffer buffers[cull_bindings_n] = {
+		[cull_binding_instances] = {
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.buffer = graphics->instancebuffer,
+			.offset = 0,
+			.range = VK_WHOLE_SIZE
+		},
+		[cull_binding_draws] = {
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.buffer = cull->draws[cull->slot],
+			.offset = 0,
+			.range = VK_WHOLE_SIZE
+		}
+	};
+
+	return descriptor_frame_set(graphics, cull->compute.set_layout,
+				    buffers, cull_bindings_n, &cull->set);
+}
+
+void record_cull(struct Graphics *graphics, VkCommandBuffer commandbuffer)
+{
+	struct cull *cull = graphics->cull;
+	VkBuffer draws = cull->draws[cull->slot];
+	int compact = !!(graphics->flags & graphics_indirect_count_flag);
+
+	struct cull_params params = {
+		.center = {graphics->mesh_center[0], graphics->mesh_center[1]},
+		.radius = graphics->mesh_radius,
+		.instances_n = graphics->instances_n,
+		.base = instance_region_offset(graphics) /
+			sizeof(struct graphics_instance),
+		.index_count = graphics->indices_n,
+		.compact = compact
+	};
+
+	view_planes(graphics, params.planes);
+
+	/*
+	 * the slot's previous frame, which drew from the buffer, retired
+	 * before recording started, only the count reset needs ordering
+	 */
+	if(compact) {
+		vkCmdFillBuffer(commandbuffer, draws, 0, sizeof(uint32_t), 0);
+
+		VkBufferMemoryBarrier reset = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+					 VK_ACCESS_SHADER_WRITE_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = draws,
+			.offset = 0,
+			.size = sizeof(uint32_t)
+		};
+
+		vkCmdPipelineBarrier(commandbuffer,
+				     VK_PIPELINE_STAGE_TRANSFER_BIT,
+				     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+				     0, 1, &reset, 0, 0);
+	}
+
+	record_dispatch(commandbuffer, &cull->compute, cull->set,
+			&params, graphics->instances_n, CULL_GROUP_SIZE);
+
+	VkBufferMemoryBarrier written = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = draws,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+
+	vkCmdPipelineBarrier(commandbuffer,
+			     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			     VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, 0, 1,
+			     &written, 0, 0);
+}
+
+void record_cull_draws(struct Graphics *graphics,
+		       VkCommandBuffer commandbuffer)
+{
+	struct cull *cull = graphics->cull;
+	VkBuffer draws = cull->draws[cull->slot];
+
+	if(graphics->flags & graphics_indirect_count_flag)
+		vkCmdDrawIndexedIndirectCount(
+			commandbuffer, draws, CULL_DRAWS_OFFSET, draws, 0,
+			graphics->instances_n,
+			sizeof(VkDrawIndexedIndirectCommand));
+	else
+		vkCmdDrawIndexedIndirect(commandbuffer, draws, CULL_DRAWS_OFFSET,
+					 graphics->instances_n,
+					 sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,68 @@
+#ifndef CULL_H
+#define CULL_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include "allocator.h"
+#include "compute.h"
+
+struct Graphics;
+
+/* local_size_x of cull.comp */
+#define CULL_GROUP_SIZE 256
+/* the draw count sits in front of the records */
+#define CULL_DRAWS_OFFSET 16
+
+/* push constants of cull.comp */
+struct cull_params {
+	/* xy normal and w distance of each view edge, pointing inside */
+	float planes[4][4];
+	/* bounding circle of the mesh */
+	float center[2];
+	float radius;
+	uint32_t instances_n;
+	/* first instance of the frame's instance region */
+	uint32_t base;
+	uint32_t index_count;
+	/* append visible draws and count them instead of one per instance */
+	uint32_t compact;
+	uint32_t pad;
+};
+
+/*
+ * GPU driven scene draws: a compute pass tests every instance's bounding
+ * circle against the view and writes a VkDrawIndexedIndirectCommand per
+ * visible instance into the frame slot's draw buffer, so recording costs
+ * the same for any instance count. With a draw count the visible draws
+ * are appended and counted; otherwise every instance keeps its record
+ * and culled ones draw zero instances.
+ */
+struct cull {
+	struct compute_pipeline compute;
+
+	/* one per frame slot */
+	VkBuffer *draws;
+	struct allocation *draw_allocations;
+
+	/* draw records each buffer holds, 0 while there are no buffers */
+	uint32_t capacity;
+	uint32_t max_draws;
+
+	/* slot of the frame being recorded and its set, from the frame pools */
+	uint32_t slot;
+	VkDescriptorSet set;
+};
+
+void destroy_cull(struct Graphics *graphics);
+
+/* whether this frame's scene draws come from the culling pass */
+int cull_active(const struct Graphics *graphics);
+/* sizes the frame slot's buffers for the instances and makes its set */
+int cull_prepare(struct Graphics *graphics);
+/* the culling pass, in front of the render pass */
+void record_cull(struct Graphics *graphics, VkCommandBuffer commandbuffer);
+void record_cull_draws(struct Graphics *graphics,
+		       VkCommandBuffer commandbuffer);
+
+#endif
@@ -0,0 +1,461 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "descriptors.h"
+#include "vksetup.h"
+
+/* the most bindings a set written through struct descriptor_buffer has */
+#define DESCRIPTOR_BUFFERS_MAX 8
+
+static const VkDescriptorPoolSize pool_sizes[] = {
+	{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DESCRIPTOR_POOL_SETS * 4},
+	{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, DESCRIPTOR_POOL_SETS},
+	{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, DESCRIPTOR_POOL_SETS}
+};
+
+static uint32_t hash_mix(uint32_t hash, uint64_t value)
+{
+	for(int i = 0; i < 8; i++) {
+		hash ^= (uint8_t) (value >> i * 8);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* field by field, the structs have padding */
+static uint32_t hash_bindings(const VkDescriptorSetLayoutBinding *bindings,
+			      const VkDescriptorBindingFlags *flags,
+			      uint32_t bindings_n)
+{
+	uint32_t hash = 2166136261u;
+
+	for(uint32_t i = 0; i < bindings_n; i++) {
+		hash = hash_mix(hash, flags ? flags[i] : 0);
+		hash = hash_mix(hash, bindings[i].binding);
+		hash = hash_mix(hash, bindings[i].descriptorType);
+		hash = hash_mix(hash, bindings[i].descriptorCount);
+		hash = hash_mix(hash, bindings[i].stageFlags);
+		hash = hash_mix(hash, (uintptr_t) bindings[i].pImmutableSamplers);
+	}
+
+	return hash;
+}
+
+static uint32_t hash_set(VkDescriptorSetLayout layout,
+			 const struct descriptor_buffer *buffers,
+			 uint32_t buffers_n)
+{
+	uint32_t hash = hash_mix(2166136261u, (uint64_t) (uintptr_t) layout);
+
+	for(uint32_t i = 0; i < buffers_n; i++) {
+		hash = hash_mix(hash, buffers[i].type);
+		hash = hash_mix(hash, (uint64_t) (uintptr_t) buffers[i].buffer);
+		hash = hash_mix(hash, buffers[i].offset);
+		hash = hash_mix(hash, buffers[i].range);
+	}
+
+	return hash;
+}
+
+static int same_bindings(const struct descriptor_layout *cached,
+			 const VkDescriptorSetLayoutBinding *b,
+			 const VkDescriptorBindingFlags *flags,
+			 uint32_t bindings_n)
+{
+	const VkDescriptorSetLayoutBinding *a = cached->bindings;
+
+	for(uint32_t i = 0; i < bindings_n; i++) {
+		if(cached->flags[i] != (flags ? flags[i] : 0))
+			return 0;
+
+		if(a[i].binding != b[i].binding ||
+		   a[i].descriptorType != b[i].descriptorType ||
+		   a[i].descriptorCount != b[i].descriptorCount ||
+		   a[i].stageFlags != b[i].stageFlags ||
+		   a[i].pImmutableSamplers != b[i].pImmutableSamplers)
+			return 0;
+	}
+
+	return 1;
+}
+
+static int same_buffers(const struct descriptor_buffer *a,
+			const struct descriptor_buffer *b, uint32_t buffers_n)
+{
+	for(uint32_t i = 0; i < buffers_n; i++) {
+		if(a[i].type != b[i].type || a[i].buffer != b[i].buffer ||
+		   a[i].offset != b[i].offset || a[i].range != b[i].range)
+			return 0;
+	}
+
+	return 1;
+}
+
+static int add_pool(struct Graphics *graphics, struct descriptor_pools *pools,
+		    VkDescriptorPoolCreateFlags flags)
+{
+	VkDescriptorPool *resized = realloc(pools->pools,
+					    sizeof(VkDescriptorPool) *
+						    (pools->pools_n + 1));
+
+	if(!resized)
+		return -1;
+
+	pools->pools = resized;
+
+	VkDescriptorPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = flags,
+		.maxSets = DESCRIPTOR_POOL_SETS,
+		.poolSizeCount = sizeof(pool_sizes) / sizeof(pool_sizes[0]),
+		.pPoolSizes = pool_sizes
+	};
+
+	VkResult res = vkCreateDescriptorPool(graphics->device, &poolInfo, 0,
+					      pools->pools + pools->pools_n);
+
+	if(res != VK_SUCCESS)
+		return -1;
+
+	pools->pools_n++;
+
+	return 0;
+}
+
+static void destroy_pools(struct Graphics *graphics,
+			  struct descriptor_pools *pools)
+{
+	for(uint32_t i = 0; i < pools->pools_n; i++)
+		vkDestroyDescriptorPool(graphics->device, pools->pools[i], 0);
+
+	free(pools->pools);
+}
+
+/* tries the pools from current on, moving on to a new one once all are full */
+static int allocate_set(struct Graphics *graphics,
+			struct descriptor_pools *pools,
+			VkDescriptorPoolCreateFlags flags,
+			VkDescriptorSetLayout layout, VkDescriptorSet *set)
+{
+	for(;;) {
+		if(pools->current == pools->pools_n &&
+		   add_pool(graphics, pools, flags) == -1)
+			return -1;
+
+		VkDescriptorSetAllocateInfo allocInfo = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = pools->pools[pools->current],
+			.descriptorSetCount = 1,
+			.pSetLayouts = &layout
+		};
+
+		VkResult res = vkAllocateDescriptorSets(graphics->device,
+							&allocInfo, set);
+
+		if(res == VK_SUCCESS)
+			return 0;
+
+		if(res != VK_ERROR_OUT_OF_POOL_MEMORY &&
+		   res != VK_ERROR_FRAGMENTED_POOL)
+			return -1;
+
+		pools->current++;
+	}
+}
+
+static void write_set(struct Graphics *graphics, VkDescriptorSet set,
+		      const struct descriptor_buffer *buffers,
+		      uint32_t buffers_n)
+{
+	VkDescriptorBufferInfo bufferInfos[DESCRIPTOR_BUFFERS_MAX];
+	VkWriteDescriptorSet writes[DESCRIPTOR_BUFFERS_MAX];
+
+	for(uint32_t i = 0; i < buffers_n; i++) {
+		bufferInfos[i] = (VkDescriptorBufferInfo) {
+			.buffer = buffers[i].buffer,
+			.offset = buffers[i].offset,
+			.range = buffers[i].range
+		};
+
+		writes[i] = (VkWriteDescriptorSet) {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = set,
+			.dstBinding = i,
+			.descriptorCount = 1,
+			.descriptorType = buffers[i].type,
+			.pBufferInfo = bufferInfos + i
+		};
+	}
+
+	vkUpdateDescriptorSets(graphics->device, buffers_n, writes, 0, 0);
+}
+
+int create_descriptors(struct Graphics *graphics)
+{
+	struct descriptors *descriptors = &graphics->descriptors;
+
+	memset(descriptors, 0, sizeof(struct descriptors));
+
+	descriptors->frames = calloc(graphics->frames_inflight,
+				     sizeof(struct descriptor_pools));
+
+	if(!descriptors->frames)
+		return -1;
+
+	return 0;
+}
+
+void destroy_descriptors(struct Graphics *graphics)
+{
+	struct descriptors *descriptors = &graphics->descriptors;
+
+	for(uint32_t i = 0; i < graphics->frames_inflight; i++)
+		destroy_pools(graphics, descriptors->frames + i);
+
+	free(descriptors->frames);
+
+	/* destroying the pools frees the sets */
+	destroy_pools(graphics, &descriptors->cached);
+
+	for(uint32_t i = 0; i < descriptors->sets_n; i++)
+		free(descriptors->sets[i].buffers);
+
+	free(descriptors->sets);
+
+	for(uint32_t i = 0; i < descriptors->layouts_n; i++) {
+		vkDestroyDescriptorSetLayout(graphics->device,
+					     descriptors->layouts[i].layout, 0);
+		free(descriptors->layouts[i].flags);
+		free(descriptors->layouts[i].bindings);
+	}
+
+	free(descriptors->layouts);
+}
+
+VkDescriptorSetLayout descriptor_layout(struct Graphics *graphics,
+					const VkDescriptorSetLayoutBinding *bindings,
+					const VkDescriptorBindingFlags *flags,
+					uint32_t bindings_n)
+{
+	struct descriptors *descriptors = &graphics->descriptors;
+	uint32_t hash = hash_bindings(bindings, flags, bindings_n);
+
+	for(uint32_t i = 0; i < descriptors->layouts_n; i++) {
+		struct descriptor_layout *cached = descriptors->layouts + i;
+
+		if(cached->hash == hash && cached->bindings_n == bindings_n &&
+		   same_bindings(cached, bindings, flags, bindings_n))
+			return cached->layout;
+	}
+
+	struct descriptor_layout *resized =
+		realloc(descriptors->layouts, sizeof(struct descriptor_layout) *
+						      (descriptors->layouts_n + 1));
+
+	if(!resized)
+		goto layouts_realloc_error;
+
+	descriptors->layouts = resized;
+
+	struct descriptor_layout *layout = resized + descriptors->layouts_n;
+
+	layout->bindings = malloc(sizeof(VkDescriptorSetLayoutBinding) *
+				  bindings_n);
+
+	if(!layout->bindings)
+		goto bindings_malloc_error;
+
+	memcpy(layout->bindings, bindings,
+	       sizeof(VkDescriptorSetLayoutBinding) * bindings_n);
+
+	layout->flags = calloc(bindings_n, sizeof(VkDescriptorBindingFlags));
+
+	if(!layout->flags)
+		goto flags_malloc_error;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = bindings_n,
+		.pBindings = bindings
+	};
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+		.bindingCount = bindings_n,
+		.pBindingFlags = flags
+	};
+
+	/* the flags struct is only valid with descriptor indexing */
+	if(flags) {
+		memcpy(layout->flags, flags,
+		       sizeof(VkDescriptorBindingFlags) * bindings_n);
+		layoutInfo.pNext = &flagsInfo;
+
+		for(uint32_t i = 0; i < bindings_n; i++) {
+			if(flags[i] & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT)
+				layoutInfo.flags |=
+					VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		}
+	}
+
+	VkResult res = vkCreateDescriptorSetLayout(graphics->device,
+						   &layoutInfo, 0,
+						   &layout->layout);
+
+	if(res != VK_SUCCESS)
+		goto layout_create_error;
+
+	layout->hash = hash;
+	layout->bindings_n = bindings_n;
+	descriptors->layouts_n++;
+
+	return layout->layout;
+
+layout_create_error:
+	free(layout->flags);
+flags_malloc_error:
+	free(layout->bindings);
+bindings_malloc_error:
+layouts_realloc_error:
+	return VK_NULL_HANDLE;
+}
+
+int descriptor_cached_set(struct Graphics *graphics,
+			  VkDescriptorSetLayout layout,
+			  const struct descriptor_buffer *buffers,
+			  uint32_t buffers_n, VkDescriptorSet *set)
+{
+	struct descriptors *descriptors = &graphics->descriptors;
+	uint32_t hash = hash_set(layout, buffers, buffers_n);
+
+	if(buffers_n > DESCRIPTOR_BUFFERS_MAX)
+		return -1;
+
+	for(uint32_t i = 0; i < descriptors->sets_n; i++) {
+		struct descriptor_set *cached = descriptors->sets + i;
+
+		if(cached->hash == hash && cached->layout == layout &&
+		   cached->buffers_n == buffers_n &&
+		   same_buffers(cached->buffers, buffers, buffers_n)) {
+			*set = cached->set;
+			return 0;
+		}
+	}
+
+	if(descriptors->sets_n == descriptors->sets_max) {
+		uint32_t sets_max = descriptors->sets_max ?
+					    descriptors->sets_max * 2 :
+					    DESCRIPTOR_POOL_SETS;
+
+		struct descriptor_set *resized = realloc(
+			descriptors->sets,
+			sizeof(struct descriptor_set) * sets_max);
+
+		if(!resized)
+			return -1;
+
+		descriptors->sets = resized;
+		descriptors->sets_max = sets_max;
+	}
+
+	struct descriptor_set *entry = descriptors->sets + descriptors->sets_n;
+
+	entry->buffers = malloc(sizeof(struct descriptor_buffer) * buffers_n);
+
+	if(!entry->buffers)
+		return -1;
+
+	/* sets freed by descriptor_forget_buffer leave room in earlier pools */
+	descriptors->cached.current = 0;
+
+	if(allocate_set(graphics, &descriptors->cached,
+			VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+			layout, &entry->set) == -1) {
+		free(entry->buffers);
+		return -1;
+	}
+
+	write_set(graphics, entry->set, buffers, buffers_n);
+
+	entry->pool = descriptors->cached.pools[descriptors->cached.current];
+	memcpy(entry->buffers, buffers,
+	       sizeof(struct descriptor_buffer) * buffers_n);
+	entry->hash = hash;
+	entry->layout = layout;
+	entry->buffers_n = buffers_n;
+	descriptors->sets_n++;
+
+	*set = entry->set;
+
+	return 0;
+}
+
+static int uses_buffer(const struct descriptor_set *set, VkBuffer buffer)
+{
+	for(uint32_t i = 0; i < set->buffers_n; i++) {
+		if(set->buffers[i].buffer == buffer)
+			return 1;
+	}
+
+	return 0;
+}
+
+void descriptor_forget_buffer(struct Graphics *graphics, VkBuffer buffer)
+{
+	struct descriptors *descriptors = &graphics->descriptors;
+
+	for(uint32_t i = 0; i < descriptors->sets_n;) {
+		struct descriptor_set *cached = descriptors->sets + i;
+
+		if(!uses_buffer(cached, buffer)) {
+			i++;
+			continue;
+		}
+
+		vkFreeDescriptorSets(graphics->device, cached->pool, 1,
+				     &cached->set);
+		free(cached->buffers);
+
+		/* order does not matter, fill the hole with the last entry */
+		*cached = descriptors->sets[--descriptors->sets_n];
+	}
+}
+
+void descriptors_frame_reset(struct Graphics *graphics)
+{
+	struct descriptor_pools *pools =
+		graphics->descriptors.frames + graphics->current_frame;
+
+	/* the pool allocations stopped in was used as well */
+	uint32_t used = pools->current < pools->pools_n ? pools->current + 1 :
+							  pools->pools_n;
+
+	for(uint32_t i = 0; i < used; i++)
+		vkResetDescriptorPool(graphics->device, pools->pools[i], 0);
+
+	pools->current = 0;
+}
+
+int descriptor_frame_set(struct Graphics *graphics,
+			 VkDescriptorSetLayout layout,
+			 const struct descriptor_buffer *buffers,
+			 uint32_t buffers_n, VkDescriptorSet *set)
+{
+	struct descriptor_pools *pools =
+		graphics->descriptors.frames + graphics->current_frame;
+
+	if(buffers_n > DESCRIPTOR_BUFFERS_MAX)
+		return -1;
+
+	if(allocate_set(graphics, pools, 0, layout, set) == -1)
+		return -1;
+
+	write_set(graphics, *set, buffers, buffers_n);
+
+	return 0;
+}
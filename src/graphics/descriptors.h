@@ -0,0 +1,96 @@
+#ifndef DESCRIPTORS_H
+#define DESCRIPTORS_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+struct Graphics;
+
+/* sets each pool holds, pools are added as they fill up */
+#define DESCRIPTOR_POOL_SETS 64
+
+struct descriptor_layout {
+	uint32_t hash;
+	uint32_t bindings_n;
+	VkDescriptorSetLayoutBinding *bindings;
+	/* zeroes for layouts made without flags */
+	VkDescriptorBindingFlags *flags;
+	VkDescriptorSetLayout layout;
+};
+
+/* what binding i of a set points at */
+struct descriptor_buffer {
+	VkDescriptorType type;
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize range;
+};
+
+struct descriptor_set {
+	uint32_t hash;
+	VkDescriptorSetLayout layout;
+	uint32_t buffers_n;
+	struct descriptor_buffer *buffers;
+	VkDescriptorSet set;
+	/* freed back into it when forgotten */
+	VkDescriptorPool pool;
+};
+
+/* filled in order, the pools after current have not been used yet */
+struct descriptor_pools {
+	VkDescriptorPool *pools;
+	uint32_t pools_n;
+	uint32_t current;
+};
+
+/*
+ * Set layouts are created once per distinct binding array and owned by
+ * the cache, so callers never destroy them. Sets come from two places:
+ * long lived ones are cached by layout and contents and stay until a
+ * buffer they point at is forgotten, while a frame's transient sets come
+ * from the frame slot's pools, reset in bulk once the slot retired.
+ * Neither is thread safe, sets are made on the render thread.
+ */
+struct descriptors {
+	struct descriptor_layout *layouts;
+	uint32_t layouts_n;
+
+	struct descriptor_set *sets;
+	uint32_t sets_n;
+	uint32_t sets_max;
+	/* the set cache's, sets are freed from them one at a time */
+	struct descriptor_pools cached;
+
+	/* one per frame in flight */
+	struct descriptor_pools *frames;
+};
+
+int create_descriptors(struct Graphics *graphics);
+void destroy_descriptors(struct Graphics *graphics);
+
+/*
+ * the cached layout for the bindings, VK_NULL_HANDLE on failure; flags is
+ * one per binding and needs descriptor indexing, 0 for none
+ */
+VkDescriptorSetLayout descriptor_layout(struct Graphics *graphics,
+					const VkDescriptorSetLayoutBinding *bindings,
+					const VkDescriptorBindingFlags *flags,
+					uint32_t bindings_n);
+
+/* a long lived set with buffers[i] at binding i, made on first use */
+int descriptor_cached_set(struct Graphics *graphics,
+			  VkDescriptorSetLayout layout,
+			  const struct descriptor_buffer *buffers,
+			  uint32_t buffers_n, VkDescriptorSet *set);
+/* frees the cached sets pointing at buffer, no frame may still use them */
+void descriptor_forget_buffer(struct Graphics *graphics, VkBuffer buffer);
+
+/* empties the current frame slot's pools, after its fence wait */
+void descriptors_frame_reset(struct Graphics *graphics);
+/* a set valid until the current frame slot comes around again */
+int descriptor_frame_set(struct Graphics *graphics,
+			 VkDescriptorSetLayout layout,
+			 const struct descriptor_buffer *buffers,
+			 uint32_t buffers_n, VkDescriptorSet *set);
+
+#endif
@@ -0,0 +1,78 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <helpers/helpers.h>
+
+#include "filemap.h"
+
+int filemap_open(const char *path, struct filemap *map, int access)
+{
+	struct stat st;
+
+	map->data = 0;
+	map->size = 0;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if(fd == -1) {
+		pdebug("%s not found", path);
+		goto open_error;
+	}
+
+	if(fstat(fd, &st) == -1 || st.st_size == 0)
+		goto stat_error;
+
+	void *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if(data == MAP_FAILED)
+		goto stat_error;
+
+	if(access == filemap_sequential) {
+		madvise(data, st.st_size, MADV_SEQUENTIAL);
+		madvise(data, st.st_size, MADV_WILLNEED);
+	} else {
+		madvise(data, st.st_size, MADV_RANDOM);
+	}
+
+	/* the mapping keeps the file referenced */
+	close(fd);
+
+	map->data = data;
+	map->size = st.st_size;
+
+	return 0;
+
+stat_error:
+	close(fd);
+open_error:
+	return -1;
+}
+
+void filemap_prefetch(const struct filemap *map, uint64_t offset,
+		      uint64_t size)
+{
+	uint64_t page = sysconf(_SC_PAGESIZE);
+	uint64_t start = offset / page * page;
+
+	if(offset >= map->size)
+		return;
+
+	if(size > map->size - offset)
+		size = map->size - offset;
+
+	madvise((char *) map->data + start, offset + size - start,
+		MADV_WILLNEED);
+}
+
+void filemap_close(struct filemap *map)
+{
+	if(!map->data)
+		return;
+
+	munmap((void *) map->data, map->size);
+
+	map->data = 0;
+	map->size = 0;
+}
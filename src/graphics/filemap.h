@@ -0,0 +1,32 @@
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Read-only view of a whole file. The pages are shared with the page
+ * cache, so loaders should hand data straight to Vulkan and close the
+ * map as soon as the objects built from it exist.
+ */
+struct filemap {
+	const void *data;
+	size_t size;
+};
+
+/* how the map will be read, picks the kernel readahead hints */
+enum filemap_access {
+	/* consumed front to back once, read ahead of it */
+	filemap_sequential,
+	/* sparse reads of a possibly huge file, callers prefetch ranges */
+	filemap_random
+};
+
+int filemap_open(const char *path, struct filemap *map, int access);
+/* starts reading [offset, offset + size) in ahead of the access */
+void filemap_prefetch(const struct filemap *map, uint64_t offset,
+		      uint64_t size);
+/* safe to call on a closed or zeroed map */
+void filemap_close(struct filemap *map);
+
+#endif
@@ -0,0 +1,233 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <graphics/setup.h>
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "instance.h"
+#include "vksetup.h"
+
+/*
+ * The instance buffer is host visible and split into one region per frame
+ * in flight, so the CPU copy can be written into a region whose frame has
+ * retired while the others are still read by the GPU. Cached recordings
+ * are replayed from any frame slot and always bind region 0 instead.
+ */
+
+static inline uint32_t instance_slot(const struct Graphics *graphics)
+{
+	if(graphics->flags & graphics_cached_commands_flag)
+		return 0;
+
+	return graphics->current_frame;
+}
+
+VkDeviceSize instance_region_offset(const struct Graphics *graphics)
+{
+	return (VkDeviceSize) instance_slot(graphics) *
+	       graphics->instance_capacity * sizeof(struct graphics_instance);
+}
+
+void mark_instances_dirty(struct Graphics *graphics, uint32_t first,
+			  uint32_t last)
+{
+	for(uint32_t i = 0; i < graphics->frames_inflight; i++) {
+		struct instance_range *dirty = graphics->instance_dirty + i;
+
+		if(dirty->first == dirty->last) {
+			dirty->first = first;
+			dirty->last = last;
+			continue;
+		}
+
+		if(first < dirty->first)
+			dirty->first = first;
+
+		if(last > dirty->last)
+			dirty->last = last;
+	}
+}
+
+static int alloc_instancebuffer(struct Graphics *graphics, uint32_t capacity)
+{
+	VkDeviceSize size = (VkDeviceSize) capacity *
+			    graphics->frames_inflight *
+			    sizeof(struct graphics_instance);
+
+	int res = create_buffer(graphics, size,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+					VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+					VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&graphics->instancebuffer,
+				&graphics->instance_allocation);
+
+	if(res == -1)
+		return -1;
+
+	graphics->instance_capacity = capacity;
+
+	return 0;
+}
+
+/* rare, so simply drains the GPU instead of retiring the old buffer */
+static int grow_instancebuffer(struct Graphics *graphics)
+{
+	uint32_t capacity = graphics->instance_capacity * 2;
+
+	if(capacity < graphics->instances_n)
+		capacity = graphics->instances_n;
+
+	vkDeviceWaitIdle(graphics->device);
+
+	if(graphics->instance_capacity)
+		destroy_buffer(graphics, graphics->instancebuffer,
+			       &graphics->instance_allocation);
+
+	if(alloc_instancebuffer(graphics, capacity) == -1) {
+		graphics->instance_capacity = 0;
+		return -1;
+	}
+
+	pdebug("instance buffer grown to %u instances", capacity);
+
+	/* every region starts empty and recordings bound the old buffer */
+	mark_instances_dirty(graphics, 0, graphics->instances_n);
+	graphics->scene_generation++;
+
+	return 0;
+}
+
+int sync_instances(struct Graphics *graphics)
+{
+	if(graphics->instances_n > graphics->instance_capacity &&
+	   grow_instancebuffer(graphics) == -1)
+		return -1;
+
+	uint32_t slot = instance_slot(graphics);
+	struct instance_range *dirty = graphics->instance_dirty + slot;
+
+	/* the set may have shrunk since the range was marked */
+	if(dirty->last > graphics->instances_n)
+		dirty->last = graphics->instances_n;
+
+	if(dirty->first >= dirty->last) {
+		dirty->first = dirty->last = 0;
+		return 0;
+	}
+
+	/* region 0 may be read by a cached recording in any frame slot */
+	if(graphics->flags & graphics_cached_commands_flag)
+		vkDeviceWaitIdle(graphics->device);
+
+	struct graphics_instance *region =
+		(struct graphics_instance *) graphics->instance_allocation.mapped +
+		(size_t) slot * graphics->instance_capacity;
+
+	memcpy(region + dirty->first, graphics->instances + dirty->first,
+	       sizeof(struct graphics_instance) * (dirty->last - dirty->first));
+
+	dirty->first = dirty->last = 0;
+
+	return 0;
+}
+
+int create_instancebuffer(struct Graphics *graphics)
+{
+	static const struct graphics_instance identity = {
+		.offset = {0, 0},
+		.scale = 1,
+		.color = {1, 1, 1}
+	};
+
+	graphics->instance_dirty =
+		calloc(graphics->frames_inflight, sizeof(struct instance_range));
+
+	if(!graphics->instance_dirty)
+		goto dirty_malloc_error;
+
+	graphics->instances = malloc(sizeof(struct graphics_instance));
+
+	if(!graphics->instances)
+		goto instances_malloc_error;
+
+	graphics->instances[0] = identity;
+	graphics->instances_n = 1;
+	graphics->instances_max = 1;
+
+	if(alloc_instancebuffer(graphics, 1) == -1)
+		goto buffer_error;
+
+	mark_instances_dirty(graphics, 0, 1);
+
+	return 0;
+
+buffer_error:
+	free(graphics->instances);
+instances_malloc_error:
+	free(graphics->instance_dirty);
+dirty_malloc_error:
+	return -1;
+}
+
+void destroy_instancebuffer(struct Graphics *graphics)
+{
+	if(graphics->instance_capacity)
+		destroy_buffer(graphics, graphics->instancebuffer,
+			       &graphics->instance_allocation);
+
+	free(graphics->instances);
+	free(graphics->instance_dirty);
+}
+
+int graphics_set_instances(struct Graphics *graphics,
+			   const struct graphics_instance *instances,
+			   uint32_t instances_n)
+{
+	if(!textures_valid(graphics, instances, instances_n))
+		return -1;
+
+	if(instances_n > graphics->instances_max) {
+		struct graphics_instance *resized = realloc(
+			graphics->instances,
+			sizeof(struct graphics_instance) * instances_n);
+
+		if(!resized)
+			return -1;
+
+		graphics->instances = resized;
+		graphics->instances_max = instances_n;
+	}
+
+	memcpy(graphics->instances, instances,
+	       sizeof(struct graphics_instance) * instances_n);
+
+	/* the instance count is baked into recorded draws */
+	if(instances_n != graphics->instances_n)
+		graphics->scene_generation++;
+
+	graphics->instances_n = instances_n;
+
+	mark_instances_dirty(graphics, 0, instances_n);
+
+	return 0;
+}
+
+int graphics_update_instances(struct Graphics *graphics, uint32_t first,
+			      const struct graphics_instance *instances,
+			      uint32_t instances_n)
+{
+	if(first > graphics->instances_n ||
+	   instances_n > graphics->instances_n - first ||
+	   !textures_valid(graphics, instances, instances_n))
+		return -1;
+
+	memcpy(graphics->instances + first, instances,
+	       sizeof(struct graphics_instance) * instances_n);
+
+	mark_instances_dirty(graphics, first, first + instances_n);
+
+	return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+struct Graphics;
+
+/* instances a frame slot's region is missing, empty when first == last */
+struct instance_range {
+	uint32_t first;
+	uint32_t last;
+};
+
+int create_instancebuffer(struct Graphics *graphics);
+void destroy_instancebuffer(struct Graphics *graphics);
+
+/* brings the current frame's region up to date, after its fence wait */
+int sync_instances(struct Graphics *graphics);
+void mark_instances_dirty(struct Graphics *graphics, uint32_t first,
+			  uint32_t last);
+
+/* byte offset of the region record_scene should bind */
+VkDeviceSize instance_region_offset(const struct Graphics *graphics);
+
+#endif
@@ -0,0 +1,383 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "mesh.h"
+
+#define NO_ENTRY UINT32_MAX
+
+static uint32_t hash_bytes(const void *data, uint32_t size)
+{
+	const uint8_t *bytes = data;
+	uint32_t hash = 2166136261u;
+
+	for(uint32_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * writes the index of every input vertex's first identical copy into
+ * indices, compacts the copies into unique, returns their count
+ */
+static uint32_t weld_vertices(const void *vertices, uint32_t vertices_n,
+			      uint32_t vertex_size, void *unique,
+			      uint32_t *indices)
+{
+	uint32_t buckets_n = 1;
+
+	while(buckets_n < vertices_n * 2)
+		buckets_n <<= 1;
+
+	uint32_t *buckets = malloc(sizeof(uint32_t) * buckets_n);
+
+	if(!buckets)
+		return 0;
+
+	memset(buckets, 0xff, sizeof(uint32_t) * buckets_n);
+
+	uint32_t unique_n = 0;
+
+	for(uint32_t i = 0; i < vertices_n; i++) {
+		const char *vertex = (const char *) vertices + (size_t) i * vertex_size;
+		uint32_t bucket = hash_bytes(vertex, vertex_size) & (buckets_n - 1);
+
+		/* linear probing, the table is never more than half full */
+		for(;;) {
+			uint32_t entry = buckets[bucket];
+
+			if(entry == NO_ENTRY) {
+				memcpy((char *) unique + (size_t) unique_n * vertex_size,
+				       vertex, vertex_size);
+
+				buckets[bucket] = unique_n;
+				indices[i] = unique_n++;
+				break;
+			}
+
+			if(!memcmp((char *) unique + (size_t) entry * vertex_size,
+				   vertex, vertex_size)) {
+				indices[i] = entry;
+				break;
+			}
+
+			bucket = (bucket + 1) & (buckets_n - 1);
+		}
+	}
+
+	free(buckets);
+
+	return unique_n;
+}
+
+struct cache_vertex {
+	int32_t cache_pos;
+	uint32_t remaining;
+	/* this vertex's live triangles in triangle_lists */
+	uint32_t first;
+	float score;
+};
+
+static float vertex_score(const struct cache_vertex *vertex)
+{
+	if(!vertex->remaining)
+		return -1;
+
+	float score = 0;
+
+	/* the last triangle's vertices get a fixed score so they are not reused at once */
+	if(vertex->cache_pos >= 3) {
+		float x = 1 - (float) (vertex->cache_pos - 3) /
+				      (MESH_CACHE_SIZE - 3);
+		score = x * sqrtf(x);
+	} else if(vertex->cache_pos >= 0) {
+		score = 0.75f;
+	}
+
+	/* favour finishing off vertices with few triangles left */
+	return score + 2.0f / sqrtf(vertex->remaining);
+}
+
+static int optimize_triangles(uint32_t *indices, uint32_t indices_n,
+			      uint32_t vertices_n)
+{
+	uint32_t triangles_n = indices_n / 3;
+	int res = -1;
+
+	struct cache_vertex *vertices =
+		calloc(vertices_n, sizeof(struct cache_vertex));
+	uint32_t *triangle_lists = malloc(sizeof(uint32_t) * indices_n);
+	float *triangle_scores = malloc(sizeof(float) * triangles_n);
+	uint8_t *emitted = calloc(triangles_n, 1);
+	uint32_t *output = malloc(sizeof(uint32_t) * indices_n);
+
+	if(!vertices || !triangle_lists || !triangle_scores || !emitted ||
+	   !output)
+		goto cleanup;
+
+	for(uint32_t i = 0; i < indices_n; i++)
+		vertices[indices[i]].remaining++;
+
+	for(uint32_t i = 0, first = 0; i < vertices_n; i++) {
+		vertices[i].first = first;
+		vertices[i].cache_pos = -1;
+		first += vertices[i].remaining;
+		/* refilled below */
+		vertices[i].remaining = 0;
+	}
+
+	for(uint32_t i = 0; i < indices_n; i++) {
+		struct cache_vertex *vertex = vertices + indices[i];
+		triangle_lists[vertex->first + vertex->remaining++] = i / 3;
+	}
+
+	for(uint32_t i = 0; i < vertices_n; i++)
+		vertices[i].score = vertex_score(vertices + i);
+
+	for(uint32_t i = 0; i < triangles_n; i++)
+		triangle_scores[i] = vertices[indices[i * 3]].score +
+				     vertices[indices[i * 3 + 1]].score +
+				     vertices[indices[i * 3 + 2]].score;
+
+	/* room for a full cache plus the three vertices pushed in front */
+	uint32_t cache[MESH_CACHE_SIZE + 3];
+	uint32_t cache_n = 0;
+	uint32_t best = NO_ENTRY;
+	uint32_t cursor = 0;
+
+	for(uint32_t emitted_n = 0; emitted_n < triangles_n; emitted_n++) {
+		/* nothing in the cache touches a live triangle, restart */
+		if(best == NO_ENTRY) {
+			for(; emitted[cursor]; cursor++);
+			best = cursor;
+		}
+
+		const uint32_t *triangle = indices + best * 3;
+
+		memcpy(output + emitted_n * 3, triangle, sizeof(uint32_t) * 3);
+		emitted[best] = 1;
+
+		uint32_t next[MESH_CACHE_SIZE + 3];
+		uint32_t next_n = 0;
+
+		for(int i = 0; i < 3; i++) {
+			struct cache_vertex *vertex = vertices + triangle[i];
+			uint32_t *list = triangle_lists + vertex->first;
+
+			for(uint32_t j = 0; j < vertex->remaining; j++) {
+				if(list[j] == best) {
+					list[j] = list[--vertex->remaining];
+					break;
+				}
+			}
+
+			next[next_n++] = triangle[i];
+		}
+
+		for(uint32_t i = 0; i < cache_n; i++) {
+			if(cache[i] != triangle[0] && cache[i] != triangle[1] &&
+			   cache[i] != triangle[2])
+				next[next_n++] = cache[i];
+		}
+
+		/* rescore everything that moved, including what fell out */
+		for(uint32_t i = 0; i < next_n; i++) {
+			struct cache_vertex *vertex = vertices + next[i];
+
+			vertex->cache_pos = i < MESH_CACHE_SIZE ? (int32_t) i : -1;
+
+			float score = vertex_score(vertex);
+			float delta = score - vertex->score;
+
+			vertex->score = score;
+
+			for(uint32_t j = 0; j < vertex->remaining; j++)
+				triangle_scores[triangle_lists[vertex->first + j]] +=
+					delta;
+		}
+
+		cache_n = next_n < MESH_CACHE_SIZE ? next_n : MESH_CACHE_SIZE;
+		memcpy(cache, next, sizeof(uint32_t) * cache_n);
+
+		best = NO_ENTRY;
+		float best_score = -1;
+
+		for(uint32_t i = 0; i < cache_n; i++) {
+			const struct cache_vertex *vertex = vertices + cache[i];
+
+			for(uint32_t j = 0; j < vertex->remaining; j++) {
+				uint32_t t = triangle_lists[vertex->first + j];
+
+				if(triangle_scores[t] > best_score) {
+					best_score = triangle_scores[t];
+					best = t;
+				}
+			}
+		}
+	}
+
+	memcpy(indices, output, sizeof(uint32_t) * triangles_n * 3);
+
+	res = 0;
+cleanup:
+	free(output);
+	free(emitted);
+	free(triangle_scores);
+	free(triangle_lists);
+	free(vertices);
+
+	return res;
+}
+
+/* renumbers vertices in the order the indices first reach them */
+static int reorder_vertices(void *vertices, uint32_t vertices_n,
+			    uint32_t vertex_size, uint32_t *indices,
+			    uint32_t indices_n)
+{
+	uint32_t *remap = malloc(sizeof(uint32_t) * vertices_n);
+	char *reordered = malloc((size_t) vertices_n * vertex_size);
+
+	if(!remap || !reordered) {
+		free(reordered);
+		free(remap);
+		return -1;
+	}
+
+	memset(remap, 0xff, sizeof(uint32_t) * vertices_n);
+
+	uint32_t next = 0;
+
+	for(uint32_t i = 0; i < indices_n; i++) {
+		uint32_t old = indices[i];
+
+		if(remap[old] == NO_ENTRY) {
+			remap[old] = next;
+			memcpy(reordered + (size_t) next * vertex_size,
+			       (char *) vertices + (size_t) old * vertex_size,
+			       vertex_size);
+			next++;
+		}
+
+		indices[i] = remap[old];
+	}
+
+	/* every welded vertex is referenced, so next == vertices_n */
+	memcpy(vertices, reordered, (size_t) vertices_n * vertex_size);
+
+	free(reordered);
+	free(remap);
+
+	return 0;
+}
+
+float mesh_acmr(const uint32_t *indices, uint32_t indices_n,
+		uint32_t vertices_n)
+{
+	uint32_t *stamps = calloc(vertices_n, sizeof(uint32_t));
+	uint32_t misses = 0;
+
+	if(!stamps || indices_n < 3) {
+		free(stamps);
+		return 0;
+	}
+
+	/* a vertex is cached while fewer than MESH_CACHE_SIZE misses followed it */
+	for(uint32_t i = 0; i < indices_n; i++) {
+		uint32_t v = indices[i];
+
+		if(stamps[v] && misses - stamps[v] < MESH_CACHE_SIZE)
+			continue;
+
+		stamps[v] = ++misses;
+	}
+
+	free(stamps);
+
+	return (float) misses / (indices_n / 3);
+}
+
+int mesh_build(struct mesh *mesh, const void *vertices, uint32_t vertices_n,
+	       uint32_t vertex_size)
+{
+	memset(mesh, 0, sizeof(struct mesh));
+
+	if(!vertices_n || vertices_n % 3)
+		goto input_error;
+
+	uint32_t *indices = malloc(sizeof(uint32_t) * vertices_n);
+
+	if(!indices)
+		goto input_error;
+
+	void *unique = malloc((size_t) vertices_n * vertex_size);
+
+	if(!unique)
+		goto unique_malloc_error;
+
+	uint32_t unique_n = weld_vertices(vertices, vertices_n, vertex_size,
+					  unique, indices);
+
+	if(!unique_n)
+		goto optimize_error;
+
+	float acmr = mesh_acmr(indices, vertices_n, unique_n);
+
+	if(optimize_triangles(indices, vertices_n, unique_n) == -1)
+		goto optimize_error;
+
+	if(reorder_vertices(unique, unique_n, vertex_size, indices,
+			    vertices_n) == -1)
+		goto optimize_error;
+
+	pdebug("mesh: %u -> %u vertices, acmr %.3f -> %.3f", vertices_n,
+	       unique_n, acmr, mesh_acmr(indices, vertices_n, unique_n));
+
+	/* shrinking can only fail to give memory back */
+	void *shrunk = realloc(unique, (size_t) unique_n * vertex_size);
+
+	mesh->vertex_size = vertex_size;
+	mesh->vertices_n = unique_n;
+	mesh->vertices = shrunk ? shrunk : unique;
+	mesh->indices_n = vertices_n;
+
+	if(unique_n <= UINT16_MAX + 1) {
+		uint16_t *narrow = (uint16_t *) indices;
+
+		/* in place, every uint16_t write lands on an index already read */
+		for(uint32_t i = 0; i < vertices_n; i++)
+			narrow[i] = indices[i];
+
+		mesh->index_type = VK_INDEX_TYPE_UINT16;
+		mesh->index_size = sizeof(uint16_t);
+	} else {
+		mesh->index_type = VK_INDEX_TYPE_UINT32;
+		mesh->index_size = sizeof(uint32_t);
+	}
+
+	mesh->indices = indices;
+
+	return 0;
+
+optimize_error:
+	free(unique);
+unique_malloc_error:
+	free(indices);
+input_error:
+	return -1;
+}
+
+void mesh_destroy(struct mesh *mesh)
+{
+	free(mesh->vertices);
+	free(mesh->indices);
+
+	mesh->vertices = 0;
+	mesh->indices = 0;
+}
@@ -0,0 +1,39 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+/* entries of the modelled post-transform vertex cache */
+#define MESH_CACHE_SIZE 32
+
+/*
+ * Indexed triangle list ready for upload. Vertices are opaque records of
+ * vertex_size bytes, so two vertices are the same only if every byte is.
+ */
+struct mesh {
+	uint32_t vertex_size;
+	uint32_t vertices_n;
+	void *vertices;
+
+	VkIndexType index_type;
+	uint32_t index_size;
+	uint32_t indices_n;
+	void *indices;
+};
+
+/*
+ * Builds a mesh from an unindexed triangle list: welds identical vertices,
+ * reorders triangles for the vertex cache (Forsyth's linear speed method),
+ * renumbers vertices in first use order and narrows indices to 16 bits
+ * when they fit.
+ */
+int mesh_build(struct mesh *mesh, const void *vertices, uint32_t vertices_n,
+	       uint32_t vertex_size);
+void mesh_destroy(struct mesh *mesh);
+
+/* average vertex shader invocations per triangle under a FIFO cache */
+float mesh_acmr(const uint32_t *indices, uint32_t indices_n,
+		uint32_t vertices_n);
+
+#endif
@@ -0,0 +1,421 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <graphics/setup.h>
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "particles.h"
+#include "shaders.h"
+#include "vksetup.h"
+
+enum particle_bindings {
+	particle_binding_state,
+	particle_binding_positions,
+	particle_bindings_n
+};
+
+static int create_points_pipeline(struct Graphics *graphics,
+				  struct particles *particles)
+{
+	VkShaderModule vertex;
+
+	VkShaderModuleCreateInfo moduleInfo = {
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = particles_vert_spv_size,
+		.pCode = particles_vert_spv
+	};
+
+	VkResult res = vkCreateShaderModule(graphics->device, &moduleInfo, 0,
+					    &vertex);
+
+	if(res != VK_SUCCESS)
+		return -1;
+
+	/* points are colored like the scene */
+	VkPipelineShaderStageCreateInfo shader_stages[shaders_n] = {
+		[fragment_shader] = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.module = graphics->shadermodules[fragment_shader],
+			.pName = "main"
+		},
+		[vertex_shader] = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_VERTEX_BIT,
+			.module = vertex,
+			.pName = "main"
+		}
+	};
+
+	VkVertexInputBindingDescription binding = {
+		.binding = 0,
+		.stride = sizeof(float) * 2,
+		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+	};
+
+	VkVertexInputAttributeDescription attribute = {
+		.location = 0,
+		.binding = 0,
+		.format = VK_FORMAT_R32G32_SFLOAT,
+		.offset = 0
+	};
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.vertexBindingDescriptionCount = 1,
+		.pVertexBindingDescriptions = &binding,
+		.vertexAttributeDescriptionCount = 1,
+		.pVertexAttributeDescriptions = &attribute
+	};
+
+	int ret = create_graphics_pipeline(graphics, shader_stages,
+					   &vertexInputInfo,
+					   VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+					   &particles->pipeline);
+
+	/* the pipeline no longer needs the module */
+	vkDestroyShaderModule(graphics->device, vertex, 0);
+
+	return ret;
+}
+
+static void destroy_particle_buffers(struct Graphics *graphics,
+				     struct particles *particles,
+				     uint32_t slots_n)
+{
+	for(uint32_t i = 0; i < slots_n; i++)
+		destroy_buffer(graphics, particles->positions[i],
+			       particles->position_allocations + i);
+
+	destroy_buffer(graphics, particles->state,
+		       &particles->state_allocation);
+}
+
+static int create_particle_buffers(struct Graphics *graphics,
+				   struct particles *particles)
+{
+	VkDeviceSize particles_n = particles->particles_n;
+	uint32_t i;
+
+	int res = create_buffer(graphics, particles_n * sizeof(float) * 4,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&particles->state,
+				&particles->state_allocation);
+
+	if(res == -1)
+		return -1;
+
+	for(i = 0; i < graphics->frames_inflight; i++) {
+		res = create_buffer(graphics, particles_n * sizeof(float) * 2,
+				    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+					    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				    particles->positions + i,
+				    particles->position_allocations + i);
+
+		if(res == -1)
+			goto positions_create_error;
+	}
+
+	return 0;
+
+positions_create_error:
+	destroy_particle_buffers(graphics, particles, i);
+
+	return -1;
+}
+
+/* long lived, the buffers only change with the particle count */
+static int create_particle_sets(struct Graphics *graphics,
+				struct particles *particles)
+{
+	for(uint32_t i = 0; i < graphics->frames_inflight; i++) {
+		struct descriptor_buffer buffers[particle_bindings_n] = {
+			[particle_binding_state] = {
+				.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.buffer = particles->state,
+				.offset = 0,
+				.range = VK_WHOLE_SIZE
+			},
+			[particle_binding_positions] = {
+				.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.buffer = particles->positions[i],
+				.offset = 0,
+				.range = VK_WHOLE_SIZE
+			}
+		};
+
+		if(descriptor_cached_set(graphics, particles->compute.set_layout,
+					 buffers, particle_bindings_n,
+					 particles->sets + i) == -1)
+			goto set_error;
+	}
+
+	return 0;
+
+set_error:
+	descriptor_forget_buffer(graphics, particles->state);
+
+	return -1;
+}
+
+static int create_step_commandbuffers(struct Graphics *graphics,
+				      struct particles *particles)
+{
+	VkCommandBufferAllocateInfo allocInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = graphics->async[async_compute].commandpool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = graphics->frames_inflight
+	};
+
+	VkResult res = vkAllocateCommandBuffers(graphics->device, &allocInfo,
+						particles->commandbuffers);
+
+	return res == VK_SUCCESS ? 0 : -1;
+}
+
+static void free_particle_arrays(struct particles *particles)
+{
+	free(particles->step_values);
+	free(particles->commandbuffers);
+	free(particles->sets);
+	free(particles->position_allocations);
+	free(particles->positions);
+}
+
+void destroy_particles(struct Graphics *graphics)
+{
+	struct particles *particles = graphics->particles;
+
+	if(!particles)
+		return;
+
+	if(particles->async)
+		vkFreeCommandBuffers(graphics->device,
+				     graphics->async[async_compute].commandpool,
+				     graphics->frames_inflight,
+				     particles->commandbuffers);
+
+	/* every set points at the state */
+	descriptor_forget_buffer(graphics, particles->state);
+	destroy_particle_buffers(graphics, particles, graphics->frames_inflight);
+	vkDestroyPipeline(graphics->device, particles->pipeline, 0);
+	destroy_compute_pipeline(graphics, &particles->compute);
+
+	free_particle_arrays(particles);
+	free(particles);
+
+	graphics->particles = 0;
+}
+
+int graphics_set_particles(Graphics *graphics, uint32_t particles_n)
+{
+	struct async_queue *compute = graphics->async + async_compute;
+	uint32_t slots_n = graphics->frames_inflight;
+
+	if(particles_n > PARTICLES_MAX)
+		return -1;
+
+	/* rare, so simply drains the GPU instead of retiring the buffers */
+	vkDeviceWaitIdle(graphics->device);
+	destroy_particles(graphics);
+
+	if(!particles_n)
+		return 0;
+
+	struct particles *particles = calloc(1, sizeof(struct particles));
+
+	if(!particles)
+		goto particles_malloc_error;
+
+	particles->particles_n = particles_n;
+	particles->reset = 1;
+	/* the handover needs a semaphore, the fence fallback steps inline */
+	particles->async = async_dedicated(compute) &&
+			   compute->semaphore != VK_NULL_HANDLE;
+
+	particles->positions = malloc(sizeof(VkBuffer) * slots_n);
+	particles->position_allocations =
+		malloc(sizeof(struct allocation) * slots_n);
+	particles->sets = malloc(sizeof(VkDescriptorSet) * slots_n);
+	particles->commandbuffers = malloc(sizeof(VkCommandBuffer) * slots_n);
+	particles->step_values = calloc(slots_n, sizeof(uint64_t));
+
+	if(!particles->positions || !particles->position_allocations ||
+	   !particles->sets || !particles->commandbuffers ||
+	   !particles->step_values)
+		goto arrays_malloc_error;
+
+	if(create_compute_pipeline(graphics, particles_comp_spv,
+				   particles_comp_spv_size, particle_bindings_n,
+				   sizeof(struct particle_step),
+				   &particles->compute) == -1)
+		goto compute_error;
+
+	if(create_points_pipeline(graphics, particles) == -1)
+		goto pipeline_error;
+
+	if(create_particle_buffers(graphics, particles) == -1)
+		goto buffers_error;
+
+	if(create_particle_sets(graphics, particles) == -1)
+		goto sets_error;
+
+	if(particles->async &&
+	   create_step_commandbuffers(graphics, particles) == -1)
+		goto commandbuffers_error;
+
+	pdebug("%u particles stepped on the %s queue", particles_n,
+	       particles->async ? "async compute" : "graphics");
+
+	graphics->particles = particles;
+
+	return 0;
+
+commandbuffers_error:
+	descriptor_forget_buffer(graphics, particles->state);
+sets_error:
+	destroy_particle_buffers(graphics, particles, slots_n);
+buffers_error:
+	vkDestroyPipeline(graphics->device, particles->pipeline, 0);
+pipeline_error:
+	destroy_compute_pipeline(graphics, &particles->compute);
+compute_error:
+arrays_malloc_error:
+	free_particle_arrays(particles);
+	free(particles);
+particles_malloc_error:
+	return -1;
+}
+
+/* integrates the state in place and writes the slot's positions */
+static void record_step(struct Graphics *graphics,
+			VkCommandBuffer commandbuffer)
+{
+	struct particles *particles = graphics->particles;
+
+	struct particle_step step = {
+		.dt = PARTICLES_STEP,
+		.particles_n = particles->particles_n,
+		.reset = particles->reset
+	};
+
+	/* the previous step wrote the state on this same queue */
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+				 VK_ACCESS_SHADER_WRITE_BIT
+	};
+
+	vkCmdPipelineBarrier(commandbuffer,
+			     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+			     &barrier, 0, 0, 0, 0);
+
+	record_dispatch(commandbuffer, &particles->compute,
+			particles->sets[particles->slot], &step,
+			particles->particles_n, PARTICLES_GROUP_SIZE);
+
+	particles->reset = 0;
+}
+
+/*
+ * The slot's positions were last drawn by the frame that used the slot
+ * before, which draw_frame already waited for, so the step can overwrite
+ * them without another dependency.
+ */
+int particles_prepare(struct Graphics *graphics)
+{
+	struct particles *particles = graphics->particles;
+	uint32_t slot = graphics->current_frame;
+
+	particles->slot = slot;
+
+	if(!particles->async)
+		return 0;
+
+	struct async_queue *compute = graphics->async + async_compute;
+	VkCommandBuffer commandbuffer = particles->commandbuffers[slot];
+
+	/* done unless the frame that waited for it failed to submit */
+	if(async_wait(graphics, async_compute,
+		      particles->step_values[slot]) == -1)
+		return -1;
+
+	VkCommandBufferBeginInfo beginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+
+	if(vkBeginCommandBuffer(commandbuffer, &beginInfo) != VK_SUCCESS)
+		return -1;
+
+	record_step(graphics, commandbuffer);
+
+	release_buffer(commandbuffer, particles->positions[slot],
+		       compute->family,
+		       graphics->queue_families.indices[queue_families_graphics],
+		       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		       VK_ACCESS_SHADER_WRITE_BIT);
+
+	if(async_submit(graphics, async_compute, commandbuffer) == -1)
+		return -1;
+
+	particles->step_values[slot] = compute->submitted;
+
+	async_frame_wait(graphics, async_compute,
+			 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+
+	return 0;
+}
+
+void record_particles_step(struct Graphics *graphics,
+			   VkCommandBuffer commandbuffer)
+{
+	struct particles *particles = graphics->particles;
+	VkBuffer positions = particles->positions[particles->slot];
+
+	if(particles->async) {
+		acquire_buffer(commandbuffer, positions,
+			       graphics->async[async_compute].family,
+			       graphics->queue_families.indices[queue_families_graphics],
+			       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			       VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		return;
+	}
+
+	record_step(graphics, commandbuffer);
+
+	VkBufferMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = positions,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+
+	vkCmdPipelineBarrier(commandbuffer,
+			     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			     VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, 0, 1,
+			     &barrier, 0, 0);
+}
+
+void record_particles(struct Graphics *graphics,
+		      VkCommandBuffer commandbuffer)
+{
+	struct particles *particles = graphics->particles;
+	VkDeviceSize offset = 0;
+
+	vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+			  particles->pipeline);
+	vkCmdBindVertexBuffers(commandbuffer, 0, 1,
+			       particles->positions + particles->slot, &offset);
+	vkCmdDraw(commandbuffer, particles->particles_n, 1, 0, 0);
+}
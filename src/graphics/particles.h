@@ -0,0 +1,72 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include "allocator.h"
+#include "compute.h"
+
+struct Graphics;
+
+/* local_size_x of particles.comp */
+#define PARTICLES_GROUP_SIZE 256
+/* the most one dimensional dispatch every device supports */
+#define PARTICLES_MAX (65535u * PARTICLES_GROUP_SIZE)
+/* simulated time per frame, fixed so runs are reproducible */
+#define PARTICLES_STEP (1.0f / 60)
+
+/* push constants of particles.comp */
+struct particle_step {
+	float dt;
+	uint32_t particles_n;
+	/* seeds the state instead of integrating it */
+	uint32_t reset;
+	uint32_t pad;
+};
+
+/*
+ * Particles live in a storage buffer integrated in place by a compute
+ * step every frame. The step also writes the positions into the frame
+ * slot's position buffer, which the scene then draws as points, so the
+ * GPU never waits on a buffer a frame in flight still reads. With an
+ * async compute queue the step runs there, overlapping the previous
+ * frame's rendering, and hands the positions over to the graphics
+ * family; otherwise it is recorded in front of the frame's render pass.
+ */
+struct particles {
+	uint32_t particles_n;
+	int async;
+	int reset;
+
+	struct compute_pipeline compute;
+	VkPipeline pipeline;
+
+	/* vec2 position, vec2 velocity per particle */
+	VkBuffer state;
+	struct allocation state_allocation;
+
+	/* one per frame slot */
+	VkBuffer *positions;
+	struct allocation *position_allocations;
+	/* from the set cache */
+	VkDescriptorSet *sets;
+	/* the async path's compute commands and their async queue values */
+	VkCommandBuffer *commandbuffers;
+	uint64_t *step_values;
+
+	/* slot of the frame being recorded */
+	uint32_t slot;
+};
+
+void destroy_particles(struct Graphics *graphics);
+
+/* runs the async step of the frame about to be recorded */
+int particles_prepare(struct Graphics *graphics);
+/* the inline step, or the async one's acquire, in front of the render pass */
+void record_particles_step(struct Graphics *graphics,
+			   VkCommandBuffer commandbuffer);
+void record_particles(struct Graphics *graphics,
+		      VkCommandBuffer commandbuffer);
+
+#endif
@@ -0,0 +1,276 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "pipelinecache.h"
+#include "vksetup.h"
+
+/* FNV-1a, only meant to catch truncated or torn files */
+static uint64_t checksum(const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	for(size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static int get_cache_path(char *path, size_t size)
+{
+	const char *dir = getenv("XDG_CACHE_HOME");
+	int len;
+
+	if(dir && *dir) {
+		len = snprintf(path, size, "%s/" PIPELINECACHE_FILE, dir);
+	} else {
+		dir = getenv("HOME");
+
+		if(!dir || !*dir)
+			return -1;
+
+		len = snprintf(path, size, "%s/.cache/" PIPELINECACHE_FILE, dir);
+	}
+
+	return len > 0 && len < size ? 0 : -1;
+}
+
+/* creates every missing directory leading up to the file in path */
+static int make_parent_dirs(const char *path)
+{
+	char dir[PATH_MAX];
+
+	strcpy(dir, path);
+
+	for(char *p = dir + 1; *p; p++) {
+		if(*p != '/')
+			continue;
+
+		*p = 0;
+
+		if(mkdir(dir, 0755) == -1 && errno != EEXIST)
+			return -1;
+
+		*p = '/';
+	}
+
+	return 0;
+}
+
+/* makes a rename into the file's directory durable */
+static int sync_parent_dir(const char *path)
+{
+	char dir[PATH_MAX];
+
+	strcpy(dir, path);
+	*strrchr(dir, '/') = 0;
+
+	int fd = open(dir, O_RDONLY | O_DIRECTORY);
+
+	if(fd == -1)
+		return -1;
+
+	int res = fsync(fd);
+
+	close(fd);
+
+	return res;
+}
+
+static void fill_header(struct Graphics *graphics,
+			struct pipelinecache_header *header)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(graphics->physicalDevice, &properties);
+
+	memset(header, 0, sizeof(struct pipelinecache_header));
+
+	header->magic = PIPELINECACHE_MAGIC;
+	header->version = PIPELINECACHE_VERSION;
+	header->vendorID = properties.vendorID;
+	header->deviceID = properties.deviceID;
+	header->driverVersion = properties.driverVersion;
+	memcpy(header->uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+/* returns the driver blob of a valid cache file, 0 otherwise */
+static void *read_cache_file(struct Graphics *graphics, const char *path,
+			     size_t *size)
+{
+	struct pipelinecache_header expected, header;
+
+	FILE *fp = fopen(path, "rb");
+
+	if(!fp)
+		goto open_error;
+
+	if(fread(&header, sizeof(header), 1, fp) != 1)
+		goto header_error;
+
+	fill_header(graphics, &expected);
+
+	if(header.magic != expected.magic ||
+	   header.version != expected.version ||
+	   header.vendorID != expected.vendorID ||
+	   header.deviceID != expected.deviceID ||
+	   header.driverVersion != expected.driverVersion ||
+	   memcmp(header.uuid, expected.uuid, VK_UUID_SIZE)) {
+		pdebug("pipeline cache %s is for another device or driver", path);
+		goto header_error;
+	}
+
+	struct stat st;
+
+	/* a corrupt size must not turn into a huge allocation */
+	if(fstat(fileno(fp), &st) == -1 ||
+	   (uint64_t) st.st_size < sizeof(header) ||
+	   header.data_size != (uint64_t) st.st_size - sizeof(header)) {
+		pdebug("pipeline cache %s is corrupt", path);
+		goto header_error;
+	}
+
+	void *data = malloc(header.data_size);
+
+	if(!data)
+		goto header_error;
+
+	if(fread(data, 1, header.data_size, fp) != header.data_size ||
+	   checksum(data, header.data_size) != header.checksum) {
+		pdebug("pipeline cache %s is corrupt", path);
+		goto data_error;
+	}
+
+	fclose(fp);
+
+	*size = header.data_size;
+
+	return data;
+
+data_error:
+	free(data);
+header_error:
+	fclose(fp);
+open_error:
+	return 0;
+}
+
+int create_pipelinecache(struct Graphics *graphics)
+{
+	char path[PATH_MAX];
+	size_t size = 0;
+	void *data = 0;
+
+	if(get_cache_path(path, sizeof(path)) == 0)
+		data = read_cache_file(graphics, path, &size);
+
+	pdebug("pipeline cache: %zu bytes loaded", size);
+
+	VkPipelineCacheCreateInfo createInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = size,
+		.pInitialData = data
+	};
+
+	VkResult res = vkCreatePipelineCache(graphics->device, &createInfo, 0,
+					     &graphics->pipelinecache);
+
+	/* a blob the driver refuses is no reason to fail, start empty */
+	if(res != VK_SUCCESS && data) {
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = 0;
+
+		res = vkCreatePipelineCache(graphics->device, &createInfo, 0,
+					    &graphics->pipelinecache);
+	}
+
+	free(data);
+
+	return res == VK_SUCCESS ? 0 : -1;
+}
+
+int save_pipelinecache(struct Graphics *graphics)
+{
+	struct pipelinecache_header header;
+	char path[PATH_MAX];
+	char tmp_path[PATH_MAX + 4];
+	size_t size;
+
+	if(get_cache_path(path, sizeof(path)) == -1)
+		goto path_error;
+
+	VkResult res = vkGetPipelineCacheData(graphics->device,
+					      graphics->pipelinecache, &size, 0);
+
+	if(res != VK_SUCCESS || !size)
+		goto path_error;
+
+	void *data = malloc(size);
+
+	if(!data)
+		goto path_error;
+
+	res = vkGetPipelineCacheData(graphics->device, graphics->pipelinecache,
+				     &size, data);
+
+	if(res != VK_SUCCESS)
+		goto data_error;
+
+	fill_header(graphics, &header);
+	header.data_size = size;
+	header.checksum = checksum(data, size);
+
+	if(make_parent_dirs(path) == -1)
+		goto data_error;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if(fd == -1)
+		goto data_error;
+
+	if(write(fd, &header, sizeof(header)) != sizeof(header) ||
+	   write(fd, data, size) != size || fsync(fd) == -1)
+		goto write_error;
+
+	close(fd);
+
+	/* readers see either the old file or the complete new one */
+	if(rename(tmp_path, path) == -1)
+		goto rename_error;
+
+	if(sync_parent_dir(path) == -1)
+		goto data_error;
+
+	pdebug("pipeline cache: %zu bytes saved to %s", size, path);
+
+	free(data);
+
+	return 0;
+
+write_error:
+	close(fd);
+rename_error:
+	unlink(tmp_path);
+data_error:
+	free(data);
+path_error:
+	return -1;
+}
+
+void destroy_pipelinecache(struct Graphics *graphics)
+{
+	vkDestroyPipelineCache(graphics->device, graphics->pipelinecache, 0);
+}
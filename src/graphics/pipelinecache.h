@@ -0,0 +1,36 @@
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+struct Graphics;
+
+#define PIPELINECACHE_MAGIC 0x43505456u /* "VTPC" */
+#define PIPELINECACHE_VERSION 1
+#define PIPELINECACHE_FILE "vulkan_test/pipeline.cache"
+
+/*
+ * Prepended to the driver's cache blob. The blob's own header carries the
+ * vendor, device and cache UUID but not the driver version, and drivers
+ * differ in how carefully they check a stale blob, so it is validated here
+ * before the driver sees it.
+ */
+struct pipelinecache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t uuid[VK_UUID_SIZE];
+	uint64_t data_size;
+	uint64_t checksum;
+};
+
+/* seeds the cache from disk when a matching file exists */
+int create_pipelinecache(struct Graphics *graphics);
+/* writes the cache back by replacing the file atomically */
+int save_pipelinecache(struct Graphics *graphics);
+void destroy_pipelinecache(struct Graphics *graphics);
+
+#endif
@@ -1,22 +1,31 @@
 #include <memory.h>
 #include <malloc.h>
 
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <sys/eventfd.h>
 #include <vulkan/vulkan_core.h>
 #include <graphics/setup.h>
 #include <window/vksurface.h>
 #include <helpers/helpers.h>
 
+#include "shaders.h"
 #include "vksetup.h"
 
-#define GRAPHICS_DIR "build/src/graphics/"
+/* development override: load SPIR-V from this directory instead */
+#define SHADER_DIR_ENV "VULKAN_TEST_SHADER_DIR"
 
 static void handle_error(int res, Graphics *graphics);
-static int init_graphics(Graphics *graphics, Window *window, uint32_t max_frames_inflight);
+static int init_graphics(Graphics *graphics, Window *window,
+			 const struct graphics_config *config);
 static const char **get_extensions(uint32_t *extensions_n);
 static const char *const *get_shader_names(void);
-static int load_shaders(char **shaders, size_t *shader_sizes);
+static int load_shaders(Graphics *graphics);
+static void unload_shaders(Graphics *graphics);
+static int create_redraw_event(Graphics *graphics);
 
 enum vksetup_statuses {
 	vksetup_shadermodules_error,
@@ -28,19 +37,31 @@ enum vksetup_statuses {
 	vksetup_physicalDevice_error,
 	vksetup_logicalDevice_error,
 	vksetup_queues_error,
+	vksetup_timeline_error,
 	vksetup_swapchain_error,
+	vksetup_pipelinecache_error,
+	vksetup_descriptors_error,
+	vksetup_uniforms_error,
 	vksetup_pipeline_error,
 	vksetup_renderpass_error,
 	vksetup_framebuffers_error,
 	vksetup_commandpool_error,
+	vksetup_async_queues_error,
+	vksetup_textures_error,
 	vksetup_vertexbuffer_error,
+	vksetup_instancebuffer_error,
+	vksetup_stream_error,
 	vksetup_commandbuffer_error,
 	vksetup_syncobjects_error,
+	vksetup_querypool_error,
+	vksetup_redraw_event_error,
 	vksetup_statuses_n
 };
 
 static const char *const errors[vksetup_statuses_n] = {
 	[vksetup_vertexbuffer_error] = "vertex buffer error",
+	[vksetup_instancebuffer_error] = "instance buffer error",
+	[vksetup_stream_error] = "stream buffer error",
 	[vksetup_shaders_error] = "shaders setup error",
 	[vksetup_imageviews_error] = "imageviews intit error",
 	[vksetup_success] = "setup success",
@@ -50,32 +71,168 @@ static const char *const errors[vksetup_statuses_n] = {
 	[vksetup_logicalDevice_error] = "logical device setup error",
 	[vksetup_queues_error] = "queeus setup error",
 	[vksetup_shadermodules_error] = "shader modules setup error",
+	[vksetup_pipelinecache_error] = "pipeline cache creation error",
+	[vksetup_descriptors_error] = "descriptor caches setup error",
+	[vksetup_uniforms_error] = "uniform ring creation error",
 	[vksetup_pipeline_error] = "pipeline init error",
 	[vksetup_framebuffers_error] = "framebuffers creation error",
 	[vksetup_renderpass_error] = "renderpass creation error",
 	[vksetup_commandpool_error] = "commandpool creation error",
+	[vksetup_async_queues_error] = "async queues setup error",
+	[vksetup_textures_error] = "texture array setup error",
 	[vksetup_commandbuffer_error] = "command buffer creation error",
 	[vksetup_syncobjects_error] = "failed creating syncobjets",
+	[vksetup_querypool_error] = "timestamp query pool creation error",
+	[vksetup_redraw_event_error] = "redraw eventfd creation error",
 	[vksetup_swapchain_error] = "swapchain setup error",
+	[vksetup_timeline_error] = "timeline creation error",
 };
 
 
 void graphics_window_resized(struct Graphics *graphics)
 {
 	graphics->flags |= graphics_window_resized_flag;
+
+	graphics_request_redraw(graphics);
+}
+
+void graphics_request_redraw(struct Graphics *graphics)
+{
+	uint64_t one = 1;
+
+	/* only fails once the counter is saturated, it is pending then */
+	if(write(graphics->redraw_fd, &one, sizeof(one)) != sizeof(one))
+		pdebug("redraw request dropped");
+}
+
+int graphics_redraw_requested(struct Graphics *graphics)
+{
+	uint64_t requests;
+
+	return read(graphics->redraw_fd, &requests, sizeof(requests)) ==
+	       sizeof(requests);
+}
+
+int graphics_get_redraw_fd(const Graphics *graphics)
+{
+	return graphics->redraw_fd;
+}
+
+void graphics_cache_commands(struct Graphics *graphics, int enable)
+{
+	if(enable)
+		graphics->flags |= graphics_cached_commands_flag;
+	else
+		graphics->flags &= ~graphics_cached_commands_flag;
+
+	/* the instance regions switch between per-frame and shared */
+	mark_instances_dirty(graphics, 0, graphics->instances_n);
+	graphics->scene_generation++;
+}
+
+void graphics_scene_dirty(struct Graphics *graphics)
+{
+	graphics->scene_generation++;
+
+	graphics_request_redraw(graphics);
 }
 
-Graphics *graphics_new(Window *window)
+int graphics_set_record_threads(struct Graphics *graphics, uint32_t threads_n)
+{
+	/* in flight frames may still execute the old workers' secondaries */
+	vkDeviceWaitIdle(graphics->device);
+
+	if(graphics->workers) {
+		workers_delete(graphics->workers);
+		graphics->workers = 0;
+	}
+
+	if(!threads_n)
+		return 0;
+
+	graphics->workers = workers_new(graphics, threads_n);
+
+	return graphics->workers ? 0 : -1;
+}
+
+void graphics_get_frame_stats(const Graphics *graphics,
+			      struct graphics_frame_stats *stats)
+{
+	*stats = graphics->frame_stats;
+}
+
+void graphics_get_memory_stats(const Graphics *graphics,
+			       struct graphics_memory_stats *stats)
+{
+	allocator_get_stats(&graphics->allocator, stats);
+}
+
+void graphics_config_init(struct graphics_config *config, int profile)
+{
+	switch(profile) {
+	case graphics_profile_low_latency:
+		/* mailbox still replaces queued images rather than tearing */
+		*config = (struct graphics_config) {
+			.present_mode = graphics_present_mailbox,
+			.frames_inflight = 1,
+			.images_n = 1
+		};
+		break;
+	case graphics_profile_throughput:
+		*config = (struct graphics_config) {
+			.present_mode = graphics_present_mailbox,
+			.frames_inflight = 3,
+			.images_n = 4
+		};
+		break;
+	default:
+		*config = (struct graphics_config) {
+			.present_mode = graphics_present_default,
+			.frames_inflight = DEFAULT_FRAMES_INFLIGHT,
+			.images_n = 0
+		};
+		break;
+	}
+}
+
+Graphics *graphics_new(Window *window, const struct graphics_config *config)
 {
 	int res;
 
-	Graphics *graphics = malloc(sizeof(Graphics));
+	Graphics *graphics = calloc(1, sizeof(Graphics));
 
 	if(!graphics)
 		return 0;
 
 
-	res = init_graphics(graphics, window, 2);
+	res = init_graphics(graphics, window, config);
+
+	if(res != vksetup_success) {
+		handle_error(res, graphics);
+		free(graphics);
+		return 0;
+	}
+
+	return graphics;
+}
+
+Graphics *graphics_new_headless(uint32_t width, uint32_t height,
+				const struct graphics_config *config)
+{
+	int res;
+
+	Graphics *graphics = calloc(1, sizeof(Graphics));
+
+	if(!graphics)
+		return 0;
+
+	graphics->flags = graphics_headless_flag;
+	graphics->swapchain_extent = (VkExtent2D) {
+		.width = width,
+		.height = height
+	};
+
+	res = init_graphics(graphics, 0, config);
 
 	if(res != vksetup_success) {
 		handle_error(res, graphics);
@@ -89,13 +246,32 @@ Graphics *graphics_new(Window *window)
 void graphics_delete(Graphics *graphics)
 {
 
+	graphics_unload_chunks(graphics);
+
 	vkDeviceWaitIdle(graphics->device);
 
+	release_retired_swapchains(graphics, 1);
+	timeline_collect(graphics, 1);
+
+	destroy_particles(graphics);
+	destroy_cull(graphics);
+
+	if(graphics->workers)
+		workers_delete(graphics->workers);
+
+	close(graphics->redraw_fd);
+
+	destroy_querypool(graphics);
 	destroy_syncobjects(graphics);
+	destroy_commandbuffers(graphics);
+	destroy_async_queues(graphics);
 	
 	vkDestroyCommandPool(graphics->device, graphics->commandpool, 0);
 
+	destroy_stream(graphics);
+	destroy_instancebuffer(graphics);
 	destroy_vertexbuffer(graphics);
+	destroy_textures(graphics);
 
 	for(int i = 0; i < graphics->framebuffers_n; i++) {
 		vkDestroyFramebuffer(graphics->device,
@@ -106,12 +282,17 @@ void graphics_delete(Graphics *graphics)
 
 	vkDestroyPipeline(graphics->device, graphics->pipeline, 0);
 	vkDestroyPipelineLayout(graphics->device, graphics->pipeline_layout, 0);
+	destroy_uniforms(graphics);
+	destroy_descriptors(graphics);
+
+	save_pipelinecache(graphics);
+	destroy_pipelinecache(graphics);
+
 	vkDestroyRenderPass(graphics->device, graphics->renderpass, 0);
 
 	for(int i = 0; i < shaders_n; i++) {
 		vkDestroyShaderModule(graphics->device,
 				      graphics->shadermodules[i], 0);
-		free(graphics->shaders[i]);
 	}
 
 	for(int i = 0; i < graphics->imageviews_n; i++) {
@@ -119,14 +300,34 @@ void graphics_delete(Graphics *graphics)
 				   0);
 	}
 
-	vkDestroySwapchainKHR(graphics->device, graphics->swapchain, 0);
+	if(graphics->flags & graphics_headless_flag)
+		destroy_offscreen_images(graphics);
+	else {
+		vkDestroySwapchainKHR(graphics->device, graphics->swapchain, 0);
+		free(graphics->images);
+	}
+
+	destroy_timeline(graphics);
+
+	struct graphics_memory_stats memory_stats;
+	allocator_get_stats(&graphics->allocator, &memory_stats);
+
+	pdebug("device memory: %u blocks, %u allocations, %llu/%llu bytes used",
+	       memory_stats.blocks_n, memory_stats.allocations_n,
+	       (unsigned long long) memory_stats.used_bytes,
+	       (unsigned long long) memory_stats.reserved_bytes);
+
+	allocator_destroy(graphics);
+
 	vkDestroyDevice(graphics->device, 0);
-	vkDestroySurfaceKHR(graphics->instance, graphics->surface, 0);
+
+	if(graphics->surface != VK_NULL_HANDLE)
+		vkDestroySurfaceKHR(graphics->instance, graphics->surface, 0);
+
 	vkDestroyInstance(graphics->instance, 0);
 	
 	swapchain_details_destroy(&graphics->swapchain_details);
 
-	free(graphics->images);
 	free(graphics->imageviews);
 
 	free(graphics);
@@ -137,14 +338,25 @@ void graphics_delete(Graphics *graphics)
 
  
 
-static int init_graphics(Graphics *graphics, Window *window, uint32_t max_frames_inflight)
+static int init_graphics(Graphics *graphics, Window *window,
+			 const struct graphics_config *config)
 {
 	int res;
 
-	graphics->flags = 0;
-	graphics->frames_inflight = max_frames_inflight;
+	int headless = graphics->flags & graphics_headless_flag;
+
+	if(config)
+		graphics->config = *config;
+	else
+		graphics_config_init(&graphics->config, graphics_profile_default);
 
-	{
+	graphics->frames_inflight = graphics->config.frames_inflight ?
+					    graphics->config.frames_inflight :
+					    DEFAULT_FRAMES_INFLIGHT;
+
+	if(headless) {
+		res = create_instance(graphics, 0, 0);
+	} else {
 		uint32_t len;
 		const char **names = get_extensions(&len);
 
@@ -156,7 +368,11 @@ static int init_graphics(Graphics *graphics, Window *window, uint32_t max_frames
 	if(res == -1)
 		return vksetup_instance_error;
 
-	res = create_surface(graphics->instance, window, &graphics->surface);
+	graphics->surface = VK_NULL_HANDLE;
+
+	if(!headless)
+		res = create_surface(graphics->instance, window,
+				     &graphics->surface);
 
 	if(res == -1)
 		return vksetup_surface_error;
@@ -177,7 +393,17 @@ static int init_graphics(Graphics *graphics, Window *window, uint32_t max_frames
 				 &graphics->queues[i]);
 	}
 
-	res = create_swapchain(graphics);
+	allocator_init(graphics);
+
+	res = create_timeline(graphics);
+
+	if(res == -1)
+		return vksetup_timeline_error;
+
+	if(headless)
+		res = create_offscreen_images(graphics);
+	else
+		res = create_swapchain(graphics);
 
 	if(res == -1)
 		return vksetup_swapchain_error;
@@ -187,7 +413,7 @@ static int init_graphics(Graphics *graphics, Window *window, uint32_t max_frames
 	if(res == -1)
 		return vksetup_imageviews_error;
 
-	res = load_shaders(graphics->shaders, graphics->shader_sizes);
+	res = load_shaders(graphics);
 	
 	if(res == -1)
 		return vksetup_shaders_error;
@@ -197,11 +423,29 @@ static int init_graphics(Graphics *graphics, Window *window, uint32_t max_frames
 	if(res == -1)
 		return vksetup_shadermodules_error;
 
+	/* the modules own a copy of the code now */
+	unload_shaders(graphics);
+
 	res = create_renderpass(graphics);
 
 	if(res == -1)
 		return vksetup_renderpass_error;
 
+	res = create_pipelinecache(graphics);
+
+	if(res == -1)
+		return vksetup_pipelinecache_error;
+
+	res = create_descriptors(graphics);
+
+	if(res == -1)
+		return vksetup_descriptors_error;
+
+	res = create_uniforms(graphics);
+
+	if(res == -1)
+		return vksetup_uniforms_error;
+
 	res = create_pipeline(graphics);
 
 	if(res == -1)
@@ -217,11 +461,31 @@ static int init_graphics(Graphics *graphics, Window *window, uint32_t max_frames
 	if(res == -1)
 		return vksetup_commandpool_error;
 
+	res = create_async_queues(graphics);
+
+	if(res == -1)
+		return vksetup_async_queues_error;
+
+	res = create_textures(graphics);
+
+	if(res == -1)
+		return vksetup_textures_error;
+
 	res = create_vertexbuffer(graphics);
 
 	if(res == -1)
 		return vksetup_vertexbuffer_error;
 
+	res = create_instancebuffer(graphics);
+
+	if(res == -1)
+		return vksetup_instancebuffer_error;
+
+	res = create_stream(graphics);
+
+	if(res == -1)
+		return vksetup_stream_error;
+
 	res = create_commandbuffers(graphics);
 
 	if(res == -1)
@@ -232,49 +496,114 @@ static int init_graphics(Graphics *graphics, Window *window, uint32_t max_frames
 	if(res == -1)
 		return vksetup_syncobjects_error;
 
+	res = create_querypool(graphics);
+
+	if(res == -1)
+		return vksetup_querypool_error;
+
+	res = create_redraw_event(graphics);
+
+	if(res == -1)
+		return vksetup_redraw_event_error;
 
 	return vksetup_success;
 }
 
 
-static int load_shaders(char **shaders, size_t *shader_sizes)
+static int load_shaders(Graphics *graphics)
 {
+	const char *dir = getenv(SHADER_DIR_ENV);
+
+	if(!dir) {
+		graphics->shaders[vertex_shader] = shader_vert_spv;
+		graphics->shader_sizes[vertex_shader] = shader_vert_spv_size;
+		graphics->shaders[fragment_shader] = shader_frag_spv;
+		graphics->shader_sizes[fragment_shader] = shader_frag_spv_size;
+
+		return 0;
+	}
+
 	const char *const *names = get_shader_names();
 
 	for (int i = 0; i < shaders_n; i++) {
-		shaders[i] = read_binary_file(names[i], shader_sizes + i);
+		char path[PATH_MAX];
 
-		if (shaders[i])
-			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+
+		pdebug("loading %s", path);
 
-		for(int j = 0; j < i; j++) {
-			free(shaders[j]);
-			shader_sizes[j] = 0;
+		struct filemap *file = graphics->shader_files + i;
+
+		if (filemap_open(path, file, filemap_sequential) == 0) {
+			graphics->shaders[i] = file->data;
+			graphics->shader_sizes[i] = file->size;
+			continue;
 		}
 
+		unload_shaders(graphics);
+
 		return -1;
 	}
 
 	return 0;
 }
 
+static void unload_shaders(Graphics *graphics)
+{
+	for(int i = 0; i < shaders_n; i++) {
+		filemap_close(graphics->shader_files + i);
+		graphics->shaders[i] = 0;
+		graphics->shader_sizes[i] = 0;
+	}
+}
+
 static const char *const *get_shader_names(void)
 {
 	static const char *const names[shaders_n] = {
-		[fragment_shader] = GRAPHICS_DIR "shader.frag.spv",
-		[vertex_shader] = GRAPHICS_DIR "shader.vert.spv"
+		[fragment_shader] = "shader.frag.spv",
+		[vertex_shader] = "shader.vert.spv"
 	};
 
 	return names;
 }
 
+static int create_redraw_event(Graphics *graphics)
+{
+	/* starts signalled so the first frame gets drawn */
+	graphics->redraw_fd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	return graphics->redraw_fd == -1 ? -1 : 0;
+}
+
 static void handle_error(int res, Graphics *graphics)
 {
+	/*
+	 * texture and vertex uploads may still be in flight, and their garbage
+	 * holds command buffers of the pools destroyed below
+	 */
+	if(graphics->timeline.garbage_n) {
+		vkDeviceWaitIdle(graphics->device);
+		timeline_collect(graphics, 1);
+	}
+
 	switch (res) {
+	case vksetup_redraw_event_error:
+		destroy_querypool(graphics);
+	case vksetup_querypool_error:
+		destroy_syncobjects(graphics);
 	case vksetup_syncobjects_error:
+		destroy_commandbuffers(graphics);
 	case vksetup_commandbuffer_error:
-		vkDestroyCommandPool(graphics->device, graphics->commandpool, 0);
+		destroy_stream(graphics);
+	case vksetup_stream_error:
+		destroy_instancebuffer(graphics);
+	case vksetup_instancebuffer_error:
+		destroy_vertexbuffer(graphics);
 	case vksetup_vertexbuffer_error:
+		destroy_textures(graphics);
+	case vksetup_textures_error:
+		destroy_async_queues(graphics);
+	case vksetup_async_queues_error:
 		vkDestroyCommandPool(graphics->device, graphics->commandpool, 0);
 	case vksetup_commandpool_error:
 		for(int i = 0; i < graphics->framebuffers_n; i++) {
@@ -287,30 +616,40 @@ static void handle_error(int res, Graphics *graphics)
 	case vksetup_framebuffers_error:
 		vkDestroyPipeline(graphics->device, graphics->pipeline, 0);
 	case vksetup_pipeline_error:
+		destroy_uniforms(graphics);
+	case vksetup_uniforms_error:
+		destroy_descriptors(graphics);
+	case vksetup_descriptors_error:
+		destroy_pipelinecache(graphics);
+	case vksetup_pipelinecache_error:
 		vkDestroyRenderPass(graphics->device, graphics->renderpass, 0);
 	case vksetup_renderpass_error:
 		for(int i = 0; i < shaders_n; i++) {
 			vkDestroyShaderModule(graphics->device, graphics->shadermodules[i], 0);
-			free(graphics->shaders[i]);
 		}
 
 	case vksetup_shadermodules_error:
-		for(int i = 0; i < shaders_n; i++){
-			free(graphics->shaders[i]);
-		}
+		unload_shaders(graphics);
 	case vksetup_shaders_error:
 		for (int i = 0; i < graphics->imageviews_n; i++) {
 			vkDestroyImageView(graphics->device,
 					   graphics->imageviews[i], 0);
 		}
 	case vksetup_imageviews_error:
-		vkDestroySwapchainKHR(graphics->device, graphics->swapchain, 0);
+		if(graphics->flags & graphics_headless_flag)
+			destroy_offscreen_images(graphics);
+		else
+			vkDestroySwapchainKHR(graphics->device, graphics->swapchain, 0);
 	case vksetup_swapchain_error:
+		destroy_timeline(graphics);
+	case vksetup_timeline_error:
+		allocator_destroy(graphics);
 		vkDestroyDevice(graphics->device, 0);
 	case vksetup_logicalDevice_error: 
 		swapchain_details_destroy(&graphics->swapchain_details);
 	case vksetup_physicalDevice_error:
-		vkDestroySurfaceKHR(graphics->instance, graphics->surface, 0);
+		if(graphics->surface != VK_NULL_HANDLE)
+			vkDestroySurfaceKHR(graphics->instance, graphics->surface, 0);
 	case vksetup_surface_error: 
 		vkDestroyInstance(graphics->instance, 0);
 	case vksetup_instance_error:
@@ -0,0 +1,26 @@
+#ifndef SHADERS_H
+#define SHADERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* SPIR-V linked in by compile_shader(... EMBED ...) */
+extern const uint32_t shader_vert_spv[];
+extern const size_t shader_vert_spv_size;
+
+extern const uint32_t shader_frag_spv[];
+extern const size_t shader_frag_spv_size;
+
+extern const uint32_t particles_comp_spv[];
+extern const size_t particles_comp_spv_size;
+
+extern const uint32_t particles_vert_spv[];
+extern const size_t particles_vert_spv_size;
+
+extern const uint32_t cull_comp_spv[];
+extern const size_t cull_comp_spv_size;
+
+extern const uint32_t textured_frag_spv[];
+extern const size_t textured_frag_spv_size;
+
+#endif
@@ -0,0 +1,187 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <graphics/setup.h>
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "stream.h"
+#include "vksetup.h"
+
+static inline VkDeviceSize align_stream(VkDeviceSize offset)
+{
+	return (offset + STREAM_ALIGNMENT - 1) & ~(VkDeviceSize) (STREAM_ALIGNMENT - 1);
+}
+
+static inline char *region_data(struct Graphics *graphics, uint32_t frame)
+{
+	return (char *) graphics->stream.allocation.mapped +
+	       (size_t) frame * STREAM_REGION_SIZE;
+}
+
+static void rewind_region(struct Graphics *graphics, uint32_t frame)
+{
+	struct stream_region *region = graphics->stream.regions + frame;
+
+	region->used = align_stream(sizeof(struct graphics_instance));
+	region->draws_n = 0;
+	region->value = 0;
+}
+
+int create_stream(struct Graphics *graphics)
+{
+	static const struct graphics_instance identity = {
+		.offset = {0, 0},
+		.scale = 1,
+		.color = {1, 1, 1}
+	};
+
+	struct stream *stream = &graphics->stream;
+
+	stream->regions = calloc(graphics->frames_inflight,
+				 sizeof(struct stream_region));
+
+	if(!stream->regions)
+		goto regions_malloc_error;
+
+	int res = create_buffer(graphics,
+				(VkDeviceSize) STREAM_REGION_SIZE *
+					graphics->frames_inflight,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+					VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+					VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&stream->buffer, &stream->allocation);
+
+	if(res == -1)
+		goto buffer_error;
+
+	for(uint32_t i = 0; i < graphics->frames_inflight; i++) {
+		memcpy(region_data(graphics, i), &identity, sizeof(identity));
+		rewind_region(graphics, i);
+	}
+
+	return 0;
+
+buffer_error:
+	free(stream->regions);
+regions_malloc_error:
+	return -1;
+}
+
+void destroy_stream(struct Graphics *graphics)
+{
+	struct stream *stream = &graphics->stream;
+
+	destroy_buffer(graphics, stream->buffer, &stream->allocation);
+
+	for(uint32_t i = 0; i < graphics->frames_inflight; i++)
+		free(stream->regions[i].draws);
+
+	free(stream->regions);
+}
+
+void stream_submitted(struct Graphics *graphics, uint64_t value)
+{
+	graphics->stream.regions[graphics->current_frame].value = value;
+}
+
+void stream_discard(struct Graphics *graphics)
+{
+	uint32_t frame = graphics->current_frame;
+
+	/* a submitted region is still read, it is rewound by the next write */
+	if(!graphics->stream.regions[frame].value)
+		rewind_region(graphics, frame);
+}
+
+int graphics_stream_geometry(struct Graphics *graphics,
+			     const struct graphics_vertex *vertices,
+			     uint32_t vertices_n, const uint32_t *indices,
+			     uint32_t indices_n)
+{
+	uint32_t frame = graphics->current_frame;
+	struct stream_region *region = graphics->stream.regions + frame;
+
+	/* replayed recordings would read whichever region they captured */
+	if(graphics->flags & graphics_cached_commands_flag)
+		return -1;
+
+	if(region->value) {
+		timeline_wait(graphics, region->value);
+		rewind_region(graphics, frame);
+	}
+
+	VkDeviceSize vertices_size = sizeof(struct graphics_vertex) * vertices_n;
+	VkDeviceSize indices_size = sizeof(uint32_t) * indices_n;
+
+	VkDeviceSize vertex_offset = region->used;
+	VkDeviceSize index_offset = align_stream(vertex_offset + vertices_size);
+	VkDeviceSize end = align_stream(index_offset + indices_size);
+
+	if(end > STREAM_REGION_SIZE)
+		return -1;
+
+	/* grows to the busiest frame's draw count, then stays */
+	if(region->draws_n == region->draws_max) {
+		uint32_t draws_max = region->draws_max ? region->draws_max * 2 : 16;
+		struct stream_draw *draws = realloc(
+			region->draws, sizeof(struct stream_draw) * draws_max);
+
+		if(!draws)
+			return -1;
+
+		region->draws = draws;
+		region->draws_max = draws_max;
+	}
+
+	char *data = region_data(graphics, frame);
+
+	memcpy(data + vertex_offset, vertices, vertices_size);
+	memcpy(data + index_offset, indices, indices_size);
+
+	region->draws[region->draws_n++] = (struct stream_draw) {
+		.vertex_offset = (VkDeviceSize) frame * STREAM_REGION_SIZE +
+				 vertex_offset,
+		.index_offset = (VkDeviceSize) frame * STREAM_REGION_SIZE +
+				index_offset,
+		.indices_n = indices_n
+	};
+
+	region->used = end;
+
+	return 0;
+}
+
+void record_stream(struct Graphics *graphics, VkCommandBuffer commandbuffer)
+{
+	uint32_t frame = graphics->current_frame;
+	struct stream *stream = &graphics->stream;
+	struct stream_region *region = stream->regions + frame;
+
+	/* written after the last submission, so still meant for this frame */
+	if(region->value || !region->draws_n)
+		return;
+
+	VkBuffer buffers[vertex_bindings_n] = {
+		[vertex_binding_vertex] = stream->buffer,
+		[vertex_binding_instance] = stream->buffer
+	};
+
+	VkDeviceSize offsets[vertex_bindings_n] = {
+		[vertex_binding_instance] = (VkDeviceSize) frame * STREAM_REGION_SIZE
+	};
+
+	for(uint32_t i = 0; i < region->draws_n; i++) {
+		const struct stream_draw *draw = region->draws + i;
+
+		offsets[vertex_binding_vertex] = draw->vertex_offset;
+
+		vkCmdBindVertexBuffers(commandbuffer, 0, vertex_bindings_n,
+				       buffers, offsets);
+		vkCmdBindIndexBuffer(commandbuffer, stream->buffer,
+				     draw->index_offset, VK_INDEX_TYPE_UINT32);
+		vkCmdDrawIndexed(commandbuffer, draw->indices_n, 1, 0, 0, 0);
+	}
+}
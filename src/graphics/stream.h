@@ -0,0 +1,53 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include "allocator.h"
+
+struct Graphics;
+
+/* bytes of streamed geometry one frame can hold */
+#define STREAM_REGION_SIZE (4u << 20)
+#define STREAM_ALIGNMENT 16
+
+struct stream_draw {
+	VkDeviceSize vertex_offset;
+	VkDeviceSize index_offset;
+	uint32_t indices_n;
+};
+
+/*
+ * One region per frame in flight, each starting with an identity instance
+ * the streamed draws bind for the instance binding. A region is written
+ * for the frame about to be recorded and rewound once the frame that last
+ * read it has completed on the timeline.
+ */
+struct stream_region {
+	VkDeviceSize used;
+	/* timeline value of the frame that last read it, 0 when unsubmitted */
+	uint64_t value;
+
+	uint32_t draws_n;
+	uint32_t draws_max;
+	struct stream_draw *draws;
+};
+
+struct stream {
+	VkBuffer buffer;
+	struct allocation allocation;
+
+	struct stream_region *regions;
+};
+
+int create_stream(struct Graphics *graphics);
+void destroy_stream(struct Graphics *graphics);
+
+/* the current frame's region was submitted, the next write must wait */
+void stream_submitted(struct Graphics *graphics, uint64_t value);
+/* drops the current frame's queued draws when it is skipped unsubmitted */
+void stream_discard(struct Graphics *graphics);
+void record_stream(struct Graphics *graphics, VkCommandBuffer commandbuffer);
+
+#endif
@@ -0,0 +1,440 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <graphics/setup.h>
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "textures.h"
+#include "vksetup.h"
+
+static uint32_t texture_capacity(const struct Graphics *graphics)
+{
+	VkPhysicalDeviceDescriptorIndexingProperties indexing = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES
+	};
+
+	VkPhysicalDeviceProperties2 properties = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &indexing
+	};
+
+	vkGetPhysicalDeviceProperties2(graphics->physicalDevice, &properties);
+
+	/* a combined image sampler counts as an image and a sampler */
+	uint32_t limits[] = {
+		TEXTURES_MAX,
+		indexing.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		indexing.maxPerStageDescriptorUpdateAfterBindSamplers,
+		indexing.maxDescriptorSetUpdateAfterBindSampledImages,
+		indexing.maxDescriptorSetUpdateAfterBindSamplers,
+		indexing.maxUpdateAfterBindDescriptorsInAllPools
+	};
+
+	uint32_t capacity = limits[0];
+
+	for(uint32_t i = 1; i < sizeof(limits) / sizeof(limits[0]); i++) {
+		if(limits[i] < capacity)
+			capacity = limits[i];
+	}
+
+	return capacity;
+}
+
+int textures_layout(struct Graphics *graphics, VkDescriptorSetLayout *layout)
+{
+	*layout = VK_NULL_HANDLE;
+
+	if(!(graphics->flags & graphics_bindless_flag))
+		return 0;
+
+	VkDescriptorSetLayoutBinding binding = {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = texture_capacity(graphics),
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+	};
+
+	/* textures are added while recorded frames are still pending */
+	VkDescriptorBindingFlags flags =
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+		VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+	*layout = descriptor_layout(graphics, &binding, &flags, 1);
+
+	return *layout == VK_NULL_HANDLE ? -1 : 0;
+}
+
+static int create_set(struct Graphics *graphics, struct textures *textures)
+{
+	VkDescriptorPoolSize poolSize = {
+		.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = textures->capacity
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &poolSize
+	};
+
+	VkResult res = vkCreateDescriptorPool(graphics->device, &poolInfo, 0,
+					      &textures->pool);
+
+	if(res != VK_SUCCESS)
+		return -1;
+
+	VkDescriptorSetAllocateInfo allocInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = textures->pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &textures->set_layout
+	};
+
+	res = vkAllocateDescriptorSets(graphics->device, &allocInfo,
+				       &textures->set);
+
+	if(res != VK_SUCCESS) {
+		vkDestroyDescriptorPool(graphics->device, textures->pool, 0);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int create_sampler(struct Graphics *graphics, struct textures *textures)
+{
+	VkSamplerCreateInfo samplerInfo = {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_LINEAR,
+		.minFilter = VK_FILTER_LINEAR,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.maxLod = 0
+	};
+
+	VkResult res = vkCreateSampler(graphics->device, &samplerInfo, 0,
+				       &textures->sampler);
+
+	return res == VK_SUCCESS ? 0 : -1;
+}
+
+static void destroy_texture(struct Graphics *graphics, struct texture *texture)
+{
+	vkDestroyImageView(graphics->device, texture->view, 0);
+	vkDestroyImage(graphics->device, texture->image, 0);
+	free_memory(graphics, &texture->allocation);
+}
+
+static void record_layout(VkCommandBuffer commandbuffer, VkImage image,
+			  VkImageLayout from, VkImageLayout to,
+			  VkAccessFlags src_access, VkAccessFlags dst_access,
+			  VkPipelineStageFlags src_stages,
+			  VkPipelineStageFlags dst_stages)
+{
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = src_access,
+		.dstAccessMask = dst_access,
+		.oldLayout = from,
+		.newLayout = to,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1
+		}
+	};
+
+	vkCmdPipelineBarrier(commandbuffer, src_stages, dst_stages, 0, 0, 0, 0,
+			     0, 1, &barrier);
+}
+
+/* copies the pixels in on the graphics queue, leaving the image sampleable */
+static int upload_texture(struct Graphics *graphics, VkImage image,
+			  uint32_t width, uint32_t height, const uint8_t *rgba)
+{
+	VkDeviceSize size = (VkDeviceSize) width * height * 4;
+	VkBuffer staging;
+	struct allocation staging_allocation;
+
+	int res = create_buffer(graphics, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+					VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&staging, &staging_allocation);
+
+	if(res == -1)
+		return -1;
+
+	memcpy(staging_allocation.mapped, rgba, size);
+
+	VkCommandBuffer commandbuffer = begin_onetime_commands(graphics);
+
+	if(commandbuffer == VK_NULL_HANDLE) {
+		destroy_buffer(graphics, staging, &staging_allocation);
+		return -1;
+	}
+
+	record_layout(commandbuffer, image, VK_IMAGE_LAYOUT_UNDEFINED,
+		      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+		      VK_ACCESS_TRANSFER_WRITE_BIT,
+		      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		      VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy region = {
+		.bufferOffset = 0,
+		.imageSubresource = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = 0,
+			.baseArrayLayer = 0,
+			.layerCount = 1
+		},
+		.imageExtent = {width, height, 1}
+	};
+
+	vkCmdCopyBufferToImage(commandbuffer, staging, image,
+			       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	record_layout(commandbuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		      VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		      VK_PIPELINE_STAGE_TRANSFER_BIT,
+		      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	res = end_onetime_commands(graphics, commandbuffer);
+
+	struct timeline_garbage garbage = {
+		.buffer = staging,
+		.allocation = staging_allocation
+	};
+
+	/* the copy may still be running when the timeline tracks it */
+	if(res == 0 && timeline_enabled(&graphics->timeline) &&
+	   timeline_defer(graphics, &garbage) == 0)
+		return 0;
+
+	timeline_wait(graphics, graphics->timeline.submitted);
+	destroy_buffer(graphics, staging, &staging_allocation);
+
+	return res;
+}
+
+static int create_texture(struct Graphics *graphics, uint32_t width,
+			  uint32_t height, const uint8_t *rgba,
+			  struct texture *texture)
+{
+	VkImageCreateInfo imageInfo = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = VK_FORMAT_R8G8B8A8_UNORM,
+		.extent = {width, height, 1},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+			 VK_IMAGE_USAGE_SAMPLED_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	VkResult res = vkCreateImage(graphics->device, &imageInfo, 0,
+				     &texture->image);
+
+	if(res != VK_SUCCESS)
+		goto image_create_error;
+
+	int alloc_res = allocate_image_memory(graphics, texture->image,
+					      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+					      &texture->allocation);
+
+	if(alloc_res == -1)
+		alloc_res = allocate_image_memory(graphics, texture->image, 0,
+						  &texture->allocation);
+
+	if(alloc_res == -1)
+		goto memory_error;
+
+	if(upload_texture(graphics, texture->image, width, height, rgba) == -1)
+		goto upload_error;
+
+	VkImageViewCreateInfo viewInfo = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.image = texture->image,
+		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.format = VK_FORMAT_R8G8B8A8_UNORM,
+		.subresourceRange = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1
+		}
+	};
+
+	res = vkCreateImageView(graphics->device, &viewInfo, 0, &texture->view);
+
+	if(res != VK_SUCCESS)
+		goto upload_error;
+
+	return 0;
+
+upload_error:
+	/* a failed upload's copy may still be pending */
+	vkDeviceWaitIdle(graphics->device);
+	free_memory(graphics, &texture->allocation);
+memory_error:
+	vkDestroyImage(graphics->device, texture->image, 0);
+image_create_error:
+	return -1;
+}
+
+static void write_texture(struct Graphics *graphics, uint32_t index)
+{
+	struct textures *textures = &graphics->textures;
+
+	VkDescriptorImageInfo imageInfo = {
+		.sampler = textures->sampler,
+		.imageView = textures->textures[index].view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	};
+
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = textures->set,
+		.dstBinding = 0,
+		.dstArrayElement = index,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &imageInfo
+	};
+
+	vkUpdateDescriptorSets(graphics->device, 1, &write, 0, 0);
+}
+
+int graphics_add_texture(Graphics *graphics, uint32_t width, uint32_t height,
+			 const uint8_t *rgba, uint32_t *texture)
+{
+	struct textures *textures = &graphics->textures;
+
+	if(!textures->set || textures->textures_n == textures->capacity ||
+	   !width || !height)
+		return -1;
+
+	uint32_t index = textures->textures_n;
+
+	if(create_texture(graphics, width, height, rgba,
+			  textures->textures + index) == -1)
+		return -1;
+
+	/* the slot is unused by every pending frame until now */
+	write_texture(graphics, index);
+	textures->textures_n++;
+
+	*texture = index;
+
+	return 0;
+}
+
+int create_textures(struct Graphics *graphics)
+{
+	static const uint8_t white[4] = {255, 255, 255, 255};
+
+	struct textures *textures = &graphics->textures;
+	uint32_t index;
+
+	memset(textures, 0, sizeof(struct textures));
+
+	if(textures_layout(graphics, &textures->set_layout) == -1)
+		goto layout_error;
+
+	if(textures->set_layout == VK_NULL_HANDLE) {
+		pdebug("bindless textures: unsupported");
+		return 0;
+	}
+
+	textures->capacity = texture_capacity(graphics);
+	textures->textures = malloc(sizeof(struct texture) *
+				    textures->capacity);
+
+	if(!textures->textures)
+		goto textures_malloc_error;
+
+	if(create_sampler(graphics, textures) == -1)
+		goto sampler_error;
+
+	if(create_set(graphics, textures) == -1)
+		goto set_error;
+
+	if(graphics_add_texture(graphics, 1, 1, white, &index) == -1)
+		goto white_error;
+
+	pdebug("bindless textures: %u", textures->capacity);
+
+	return 0;
+
+white_error:
+	vkDestroyDescriptorPool(graphics->device, textures->pool, 0);
+set_error:
+	vkDestroySampler(graphics->device, textures->sampler, 0);
+sampler_error:
+	free(textures->textures);
+textures_malloc_error:
+layout_error:
+	return -1;
+}
+
+int textures_valid(const struct Graphics *graphics,
+		   const struct graphics_instance *instances,
+		   uint32_t instances_n)
+{
+	/* the array is partially bound, unwritten slots must never be read */
+	for(uint32_t i = 0; i < instances_n; i++) {
+		if(instances[i].texture &&
+		   instances[i].texture >= graphics->textures.textures_n)
+			return 0;
+	}
+
+	return 1;
+}
+
+void bind_textures(struct Graphics *graphics, VkCommandBuffer commandbuffer)
+{
+	struct textures *textures = &graphics->textures;
+
+	if(!textures->set)
+		return;
+
+	vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+				graphics->pipeline_layout, 1, 1, &textures->set,
+				0, 0);
+}
+
+void destroy_textures(struct Graphics *graphics)
+{
+	struct textures *textures = &graphics->textures;
+
+	if(!textures->set)
+		return;
+
+	/* a deferred upload may still be writing the images */
+	vkDeviceWaitIdle(graphics->device);
+	timeline_collect(graphics, 1);
+
+	for(uint32_t i = 0; i < textures->textures_n; i++)
+		destroy_texture(graphics, textures->textures + i);
+
+	vkDestroyDescriptorPool(graphics->device, textures->pool, 0);
+	vkDestroySampler(graphics->device, textures->sampler, 0);
+	free(textures->textures);
+}
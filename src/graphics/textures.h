@@ -0,0 +1,56 @@
+#ifndef TEXTURES_H
+#define TEXTURES_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include "allocator.h"
+
+struct Graphics;
+struct graphics_instance;
+
+/* the array's size unless the device allows fewer */
+#define TEXTURES_MAX 4096
+
+struct texture {
+	VkImage image;
+	struct allocation allocation;
+	VkImageView view;
+};
+
+/*
+ * Bindless textures: every texture sits in one large partially bound,
+ * update after bind array of combined image samplers in set 1, indexed
+ * by struct graphics_instance's texture, so instances with different
+ * textures still share a draw. Texture 0 is white, the default for every
+ * instance. Needs the Vulkan 1.2 descriptor indexing features, without
+ * them there is no array and the scene is drawn untextured.
+ */
+struct textures {
+	uint32_t capacity;
+	uint32_t textures_n;
+	struct texture *textures;
+
+	VkSampler sampler;
+	/* from the layout cache */
+	VkDescriptorSetLayout set_layout;
+	/* update after bind sets need a pool of their own */
+	VkDescriptorPool pool;
+	VkDescriptorSet set;
+};
+
+/* the array's layout, VK_NULL_HANDLE without bindless support */
+int textures_layout(struct Graphics *graphics, VkDescriptorSetLayout *layout);
+
+int create_textures(struct Graphics *graphics);
+void destroy_textures(struct Graphics *graphics);
+
+/* whether every instance's texture has been added, 0 always has */
+int textures_valid(const struct Graphics *graphics,
+		   const struct graphics_instance *instances,
+		   uint32_t instances_n);
+
+/* binds the array as set 1 of the scene pipelines, if there is one */
+void bind_textures(struct Graphics *graphics, VkCommandBuffer commandbuffer);
+
+#endif
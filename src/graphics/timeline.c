@@ -0,0 +1,207 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "timeline.h"
+#include "vksetup.h"
+
+int create_timeline(struct Graphics *graphics)
+{
+	struct timeline *timeline = &graphics->timeline;
+
+	timeline->frame_values =
+		calloc(graphics->frames_inflight, sizeof(uint64_t));
+
+	if(!timeline->frame_values)
+		goto frame_values_malloc_error;
+
+	if(!(graphics->flags & graphics_timeline_flag))
+		return 0;
+
+	VkSemaphoreTypeCreateInfo typeInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0
+	};
+
+	VkSemaphoreCreateInfo semaphoreInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &typeInfo
+	};
+
+	VkResult res = vkCreateSemaphore(graphics->device, &semaphoreInfo, 0,
+					 &timeline->semaphore);
+
+	if(res != VK_SUCCESS)
+		goto semaphore_create_error;
+
+	return 0;
+
+semaphore_create_error:
+	free(timeline->frame_values);
+frame_values_malloc_error:
+	return -1;
+}
+
+void destroy_timeline(struct Graphics *graphics)
+{
+	struct timeline *timeline = &graphics->timeline;
+
+	timeline_collect(graphics, 1);
+
+	vkDestroySemaphore(graphics->device, timeline->semaphore, 0);
+
+	free(timeline->garbage);
+	free(timeline->frame_values);
+}
+
+void timeline_submitted(struct Graphics *graphics)
+{
+	graphics->timeline.submitted++;
+}
+
+uint64_t timeline_completed(struct Graphics *graphics)
+{
+	struct timeline *timeline = &graphics->timeline;
+
+	if(timeline_enabled(timeline)) {
+		uint64_t value;
+
+		if(vkGetSemaphoreCounterValue(graphics->device,
+					      timeline->semaphore,
+					      &value) == VK_SUCCESS)
+			timeline->completed = value;
+
+		return timeline->completed;
+	}
+
+	/* submissions complete in order, the newest signalled fence wins */
+	for(uint32_t i = 0; i < graphics->frames_inflight; i++) {
+		uint64_t value = timeline->frame_values[i];
+
+		if(value > timeline->completed &&
+		   vkGetFenceStatus(graphics->device,
+				    graphics->inflight_fences[i]) == VK_SUCCESS)
+			timeline->completed = value;
+	}
+
+	return timeline->completed;
+}
+
+/*
+ * Only slots holding a value past completed can be pending, and their
+ * fences have not been reset yet: a slot's fence is waited on before it
+ * is reset for the next submission.
+ */
+static int wait_frame_fence(struct Graphics *graphics, uint64_t value)
+{
+	struct timeline *timeline = &graphics->timeline;
+	uint32_t slot = UINT32_MAX;
+
+	for(uint32_t i = 0; i < graphics->frames_inflight; i++) {
+		uint64_t slot_value = timeline->frame_values[i];
+
+		if(slot_value < value || slot_value <= timeline->completed)
+			continue;
+
+		if(slot == UINT32_MAX || slot_value < timeline->frame_values[slot])
+			slot = i;
+	}
+
+	if(slot == UINT32_MAX)
+		return 0;
+
+	VkResult res = vkWaitForFences(graphics->device, 1,
+				       graphics->inflight_fences + slot,
+				       VK_TRUE, UINT64_MAX);
+
+	if(res != VK_SUCCESS)
+		return -1;
+
+	timeline->completed = timeline->frame_values[slot];
+
+	return 0;
+}
+
+int timeline_wait(struct Graphics *graphics, uint64_t value)
+{
+	struct timeline *timeline = &graphics->timeline;
+
+	if(value <= timeline->completed || value > timeline->submitted)
+		return 0;
+
+	if(!timeline_enabled(timeline))
+		return wait_frame_fence(graphics, value);
+
+	VkSemaphoreWaitInfo waitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &timeline->semaphore,
+		.pValues = &value
+	};
+
+	if(vkWaitSemaphores(graphics->device, &waitInfo, UINT64_MAX) !=
+	   VK_SUCCESS)
+		return -1;
+
+	timeline->completed = value;
+
+	return 0;
+}
+
+void timeline_collect(struct Graphics *graphics, int idle)
+{
+	struct timeline *timeline = &graphics->timeline;
+
+	if(!timeline->garbage_n)
+		return;
+
+	uint64_t completed = idle ? UINT64_MAX : timeline_completed(graphics);
+	uint32_t kept = 0;
+
+	for(uint32_t i = 0; i < timeline->garbage_n; i++) {
+		struct timeline_garbage *garbage = timeline->garbage + i;
+
+		if(garbage->value > completed) {
+			timeline->garbage[kept++] = *garbage;
+			continue;
+		}
+
+		if(garbage->commandbuffer != VK_NULL_HANDLE)
+			vkFreeCommandBuffers(graphics->device,
+					     garbage->commandpool, 1,
+					     &garbage->commandbuffer);
+
+		if(garbage->buffer != VK_NULL_HANDLE)
+			destroy_buffer(graphics, garbage->buffer,
+				       &garbage->allocation);
+	}
+
+	timeline->garbage_n = kept;
+}
+
+int timeline_defer(struct Graphics *graphics,
+		   const struct timeline_garbage *garbage)
+{
+	struct timeline *timeline = &graphics->timeline;
+
+	if(timeline->garbage_n == timeline->garbage_max) {
+		uint32_t max = timeline->garbage_max ? timeline->garbage_max * 2 : 8;
+		struct timeline_garbage *resized =
+			realloc(timeline->garbage,
+				sizeof(struct timeline_garbage) * max);
+
+		if(!resized)
+			return -1;
+
+		timeline->garbage = resized;
+		timeline->garbage_max = max;
+	}
+
+	timeline->garbage[timeline->garbage_n] = *garbage;
+	timeline->garbage[timeline->garbage_n++].value = timeline->submitted;
+
+	return 0;
+}
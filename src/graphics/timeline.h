@@ -0,0 +1,70 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include "allocator.h"
+
+struct Graphics;
+
+/* resources freed once the submission with value has completed */
+struct timeline_garbage {
+	uint64_t value;
+	VkCommandPool commandpool;
+	VkCommandBuffer commandbuffer;
+	VkBuffer buffer;
+	struct allocation allocation;
+};
+
+/*
+ * GPU progress as one increasing counter: every submission to the
+ * graphics queue is numbered, so anything it used can be tracked with a
+ * single value and tested with one compare. Backed by a timeline
+ * semaphore on Vulkan 1.2 devices. The fence fallback only numbers
+ * frames, tracked through their slot's fence, and drains the queue after
+ * any other submission.
+ */
+struct timeline {
+	/* VK_NULL_HANDLE on the fence fallback */
+	VkSemaphore semaphore;
+
+	uint64_t submitted;
+	uint64_t completed;
+
+	/* value of the last submission of each frame slot */
+	uint64_t *frame_values;
+
+	uint32_t garbage_n;
+	uint32_t garbage_max;
+	struct timeline_garbage *garbage;
+};
+
+int create_timeline(struct Graphics *graphics);
+void destroy_timeline(struct Graphics *graphics);
+
+static inline int timeline_enabled(const struct timeline *timeline)
+{
+	return timeline->semaphore != VK_NULL_HANDLE;
+}
+
+/* value the next submission signals */
+static inline uint64_t timeline_next(const struct timeline *timeline)
+{
+	return timeline->submitted + 1;
+}
+
+/* records a successful submission of timeline_next */
+void timeline_submitted(struct Graphics *graphics);
+/* refreshes and returns the last completed value without blocking */
+uint64_t timeline_completed(struct Graphics *graphics);
+/* blocks until value completed, values never submitted return at once */
+int timeline_wait(struct Graphics *graphics, uint64_t value);
+
+/* frees garbage whose submission completed, or all of it when idle */
+void timeline_collect(struct Graphics *graphics, int idle);
+/* queues garbage freed after the last submission completes */
+int timeline_defer(struct Graphics *graphics,
+		   const struct timeline_garbage *garbage);
+
+#endif
@@ -0,0 +1,180 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <graphics/setup.h>
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "uniforms.h"
+#include "vksetup.h"
+
+_Static_assert(sizeof(struct camera_uniform) <= UNIFORM_BLOCK_SIZE,
+	       "the camera must fit a block");
+
+static const struct draw_constants identity = {
+	.offset = {0, 0},
+	.scale = 1
+};
+
+static int create_set(struct Graphics *graphics, struct uniforms *uniforms)
+{
+	VkDescriptorSetLayoutBinding binding = {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+	};
+
+	uniforms->set_layout = descriptor_layout(graphics, &binding, 0, 1);
+
+	if(uniforms->set_layout == VK_NULL_HANDLE)
+		return -1;
+
+	/* the dynamic offset is added to this at bind time */
+	struct descriptor_buffer block = {
+		.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.buffer = uniforms->buffer,
+		.offset = 0,
+		.range = UNIFORM_BLOCK_SIZE
+	};
+
+	return descriptor_cached_set(graphics, uniforms->set_layout, &block, 1,
+				     &uniforms->set);
+}
+
+int create_uniforms(struct Graphics *graphics)
+{
+	struct uniforms *uniforms = &graphics->uniforms;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(graphics->physicalDevice, &properties);
+
+	VkDeviceSize alignment =
+		properties.limits.minUniformBufferOffsetAlignment;
+
+	/* the alignment is a power of two */
+	uniforms->stride = (UNIFORM_BLOCK_SIZE + alignment - 1) &
+			   ~(alignment - 1);
+
+	VkDeviceSize size = uniforms->stride * UNIFORM_SLOT_BLOCKS *
+			    graphics->frames_inflight;
+
+	int res = create_buffer(graphics, size,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+					VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&uniforms->buffer, &uniforms->allocation);
+
+	if(res == -1)
+		return -1;
+
+	if(create_set(graphics, uniforms) == -1) {
+		destroy_buffer(graphics, uniforms->buffer,
+			       &uniforms->allocation);
+		return -1;
+	}
+
+	uniforms->camera = (struct camera_uniform) {
+		.center = {0, 0},
+		.scale = {1, 1}
+	};
+
+	uniforms->camera_dirty = 1;
+
+	return 0;
+}
+
+void destroy_uniforms(struct Graphics *graphics)
+{
+	struct uniforms *uniforms = &graphics->uniforms;
+
+	descriptor_forget_buffer(graphics, uniforms->buffer);
+	destroy_buffer(graphics, uniforms->buffer, &uniforms->allocation);
+}
+
+int uniform_push(struct Graphics *graphics, const void *data, uint32_t size,
+		 uint32_t *offset)
+{
+	struct uniforms *uniforms = &graphics->uniforms;
+
+	if(size > UNIFORM_BLOCK_SIZE || uniforms->used == UNIFORM_SLOT_BLOCKS)
+		return -1;
+
+	VkDeviceSize at = uniforms->stride *
+			  ((VkDeviceSize) uniforms->slot * UNIFORM_SLOT_BLOCKS +
+			   uniforms->used++);
+
+	memcpy((char *) uniforms->allocation.mapped + at, data, size);
+
+	*offset = at;
+
+	return 0;
+}
+
+int uniforms_prepare(struct Graphics *graphics)
+{
+	struct uniforms *uniforms = &graphics->uniforms;
+
+	if(!(graphics->flags & graphics_cached_commands_flag)) {
+		uniforms->slot = graphics->current_frame;
+		uniforms->used = 0;
+
+		return uniform_push(graphics, &uniforms->camera,
+				    sizeof(struct camera_uniform),
+				    &uniforms->camera_offset);
+	}
+
+	uniforms->slot = 0;
+	uniforms->used = 0;
+
+	if(!uniforms->camera_dirty) {
+		uniforms->used = 1;
+		uniforms->camera_offset = 0;
+		return 0;
+	}
+
+	/* slot 0 may be read by a cached recording in any frame slot */
+	vkDeviceWaitIdle(graphics->device);
+
+	if(uniform_push(graphics, &uniforms->camera,
+			sizeof(struct camera_uniform),
+			&uniforms->camera_offset) == -1)
+		return -1;
+
+	uniforms->camera_dirty = 0;
+
+	return 0;
+}
+
+void bind_uniforms(struct Graphics *graphics, VkCommandBuffer commandbuffer)
+{
+	struct uniforms *uniforms = &graphics->uniforms;
+
+	vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+				graphics->pipeline_layout, 0, 1, &uniforms->set,
+				1, &uniforms->camera_offset);
+
+	push_draw_constants(graphics, commandbuffer, &identity);
+}
+
+void push_draw_constants(struct Graphics *graphics,
+			 VkCommandBuffer commandbuffer,
+			 const struct draw_constants *constants)
+{
+	vkCmdPushConstants(commandbuffer, graphics->pipeline_layout,
+			   VK_SHADER_STAGE_VERTEX_BIT, 0,
+			   sizeof(struct draw_constants), constants);
+}
+
+void graphics_set_camera(struct Graphics *graphics, const float center[2],
+			 float zoom)
+{
+	struct uniforms *uniforms = &graphics->uniforms;
+
+	uniforms->camera = (struct camera_uniform) {
+		.center = {center[0], center[1]},
+		.scale = {zoom, zoom}
+	};
+
+	uniforms->camera_dirty = 1;
+}
@@ -0,0 +1,73 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include "allocator.h"
+
+struct Graphics;
+
+/* the range every dynamic offset exposes to the shaders */
+#define UNIFORM_BLOCK_SIZE 256
+/* blocks each frame slot can hand out */
+#define UNIFORM_SLOT_BLOCKS 64
+
+/* std140 Camera block of shader.vert and particles.vert */
+struct camera_uniform {
+	float center[2];
+	float scale[2];
+};
+
+/* push constants of the scene pipelines, a transform per draw */
+struct draw_constants {
+	float offset[2];
+	float scale;
+	float pad;
+};
+
+/*
+ * Uniform data lives in one persistently mapped ring with a slot of
+ * UNIFORM_SLOT_BLOCKS blocks per frame in flight. Blocks are handed out
+ * from the current frame's slot and all read through a single
+ * VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC set, the dynamic offset picks
+ * the block. Cached recordings are replayed from any frame slot, so like
+ * the instance regions they always read slot 0.
+ */
+struct uniforms {
+	VkBuffer buffer;
+	struct allocation allocation;
+	/* UNIFORM_BLOCK_SIZE rounded up to minUniformBufferOffsetAlignment */
+	VkDeviceSize stride;
+
+	uint32_t slot;
+	/* blocks handed out from the slot this frame */
+	uint32_t used;
+
+	/* from the descriptor caches */
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorSet set;
+
+	struct camera_uniform camera;
+	/* slot 0 is only rewritten for cached recordings when set */
+	int camera_dirty;
+	/* dynamic offset of the frame's camera block */
+	uint32_t camera_offset;
+};
+
+int create_uniforms(struct Graphics *graphics);
+void destroy_uniforms(struct Graphics *graphics);
+
+/* starts the frame slot's blocks and writes the camera, after its fence wait */
+int uniforms_prepare(struct Graphics *graphics);
+/* copies size bytes into a block of the frame slot, for recording only */
+int uniform_push(struct Graphics *graphics, const void *data, uint32_t size,
+		 uint32_t *offset);
+
+/* binds the camera and an identity transform for the scene pipelines */
+void bind_uniforms(struct Graphics *graphics, VkCommandBuffer commandbuffer);
+void push_draw_constants(struct Graphics *graphics,
+			 VkCommandBuffer commandbuffer,
+			 const struct draw_constants *constants);
+
+#endif
@@ -1,5 +1,8 @@
 #include "vertex.h"
+#include <math.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <graphics/setup.h>
 #include <helpers/helpers.h>
 
 struct vertex {
@@ -7,6 +10,14 @@ struct vertex {
 	float color[3];
 };
 
+/* streamed geometry reuses the pipeline's vertex layout */
+_Static_assert(sizeof(struct vertex) == sizeof(struct graphics_vertex) &&
+	       offsetof(struct vertex, pos) ==
+		       offsetof(struct graphics_vertex, pos) &&
+	       offsetof(struct vertex, color) ==
+		       offsetof(struct graphics_vertex, color),
+	       "struct vertex must match struct graphics_vertex");
+
 uint32_t vertex_size(void)
 {
 	return sizeof(struct vertex);
@@ -24,43 +35,81 @@ const struct vertex *get_vertices(uint32_t *vertices_n)
 		
 	};
 
-
-	pdebug("sizeof pos: %lu", sizeof(vertices[0].pos));
+	/* an unindexed triangle list, mesh_build welds the shared corners */
 
 	*vertices_n = sizeof(vertices) / sizeof(struct vertex);
 
 	return vertices;
 }
 
+void vertex_bounds(const struct vertex *vertices, uint32_t vertices_n,
+		   float center[2], float *radius)
+{
+	float min[2] = {INFINITY, INFINITY};
+	float max[2] = {-INFINITY, -INFINITY};
+
+	for(uint32_t i = 0; i < vertices_n; i++) {
+		for(int axis = 0; axis < 2; axis++) {
+			if(vertices[i].pos[axis] < min[axis])
+				min[axis] = vertices[i].pos[axis];
+			if(vertices[i].pos[axis] > max[axis])
+				max[axis] = vertices[i].pos[axis];
+		}
+	}
+
+	center[0] = (min[0] + max[0]) / 2;
+	center[1] = (min[1] + max[1]) / 2;
+	*radius = hypotf(max[0] - center[0], max[1] - center[1]);
+}
+
 const VkVertexInputBindingDescription *
 vertex_vkbinding_descriptions(uint32_t *binding_descriptions_n)
 {
-	static VkVertexInputBindingDescription description = {
-		.binding = 0,
-		.stride = sizeof(struct vertex),
-		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+	static VkVertexInputBindingDescription descriptions[vertex_bindings_n] = {
+		{ .binding = vertex_binding_vertex,
+		  .stride = sizeof(struct vertex),
+		  .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
+		{ .binding = vertex_binding_instance,
+		  .stride = sizeof(struct graphics_instance),
+		  .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE }
 	};
 
-	*binding_descriptions_n = 1;
+	*binding_descriptions_n = vertex_bindings_n;
 
-	return &description;
+	return descriptions;
 }
 
 const VkVertexInputAttributeDescription *
 vertex_vkattribute_descriptions(uint32_t *attributes_n)
 {
-	static VkVertexInputAttributeDescription descriptions[2] = {
-		{ .binding = 0,
+	static VkVertexInputAttributeDescription descriptions[6] = {
+		{ .binding = vertex_binding_vertex,
 		  .location = 0,
 		  .format = VK_FORMAT_R32G32_SFLOAT,
 		  .offset = offsetof(struct vertex, pos) },
-		{ .binding = 0,
+		{ .binding = vertex_binding_vertex,
 		  .location = 1,
 		  .format = VK_FORMAT_R32G32B32_SFLOAT,
-		  .offset = offsetof(struct vertex, color) }
+		  .offset = offsetof(struct vertex, color) },
+		{ .binding = vertex_binding_instance,
+		  .location = 2,
+		  .format = VK_FORMAT_R32G32_SFLOAT,
+		  .offset = offsetof(struct graphics_instance, offset) },
+		{ .binding = vertex_binding_instance,
+		  .location = 3,
+		  .format = VK_FORMAT_R32_SFLOAT,
+		  .offset = offsetof(struct graphics_instance, scale) },
+		{ .binding = vertex_binding_instance,
+		  .location = 4,
+		  .format = VK_FORMAT_R32G32B32_SFLOAT,
+		  .offset = offsetof(struct graphics_instance, color) },
+		{ .binding = vertex_binding_instance,
+		  .location = 5,
+		  .format = VK_FORMAT_R32_UINT,
+		  .offset = offsetof(struct graphics_instance, texture) }
 	};
 
-	*attributes_n = 2;
+	*attributes_n = 6;
 
 	return descriptions;
 }
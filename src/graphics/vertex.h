@@ -5,12 +5,21 @@
 
 struct vertex;
 
+enum vertex_bindings {
+	vertex_binding_vertex,
+	vertex_binding_instance,
+	vertex_bindings_n
+};
+
 const VkVertexInputBindingDescription *
 vertex_vkbinding_descriptions(uint32_t *binding_descriptions_n);
 
 uint32_t vertex_size(void);
 
 const struct vertex *get_vertices(uint32_t *vertices_n);
+/* smallest circle around the bounding box of the vertices' positions */
+void vertex_bounds(const struct vertex *vertices, uint32_t vertices_n,
+		   float center[2], float *radius);
 
 const VkVertexInputAttributeDescription *
 vertex_vkattribute_descriptions(uint32_t *attributes_n);
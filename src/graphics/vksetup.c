@@ -8,17 +8,21 @@
 #include <string.h>
 
 #include <helpers/helpers.h>
+#include <helpers/timer.h>
 #include <vulkan/vulkan_core.h>
 
+#include "shaders.h"
 #include "vksetup.h"
 
-static VkPresentModeKHR
-get_presentmode(const struct swapchain_details *swapchain_details);
+/* forces the fence fallback on devices with timeline semaphores */
+#define NO_TIMELINE_ENV "VULKAN_TEST_NO_TIMELINE"
+
+static VkPresentModeKHR get_presentmode(const struct Graphics *graphics);
 static VkSurfaceFormatKHR get_format(const struct swapchain_details *swapchain_details);
 
 static VkExtent2D get_swapextent(const struct swapchain_details *swapchain_detail);
 
-static uint32_t get_images_n(const struct swapchain_details *swapchain_details);
+static uint32_t get_images_n(const struct Graphics *graphics);
 
 static int first_missing_extension(uint32_t extensions_n,
 				   const char *const *extensions,
@@ -45,23 +49,20 @@ static int check_instance_extensions_support(uint32_t extensions_n,
 static const char *const *get_layers(uint32_t *layers_n);
 static const char *const *get_device_exttensions(uint32_t *extensions_n);
 
-static void destroy_swapchain(struct Graphics *graphics);
-
-static VkResult init_swapchain(struct Graphics *graphics);
+static VkResult init_swapchain(struct Graphics *graphics,
+				VkSwapchainKHR old);
 static VkResult init_imageviews(struct Graphics *graphics);
 static VkResult init_framebufers(struct Graphics *graphics);
 
-static int find_memory_type(struct Graphics *graphics, uint32_t filter,
-				 VkMemoryPropertyFlags properties)
+int find_memory_type(struct Graphics *graphics, uint32_t filter,
+		     VkMemoryPropertyFlags properties)
 {
+	const VkPhysicalDeviceMemoryProperties *memProperties =
+		&graphics->allocator.properties;
 
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(graphics->physicalDevice,
-					    &memProperties);
-
-	for(int i = 0; i < memProperties.memoryTypeCount; i++) {
+	for(int i = 0; i < memProperties->memoryTypeCount; i++) {
 		if ((filter & (1 << i)) &&
-		    ((memProperties.memoryTypes[i].propertyFlags &
+		    ((memProperties->memoryTypes[i].propertyFlags &
 		      properties) == properties))
 			return i;
 	}
@@ -69,99 +70,512 @@ static int find_memory_type(struct Graphics *graphics, uint32_t filter,
 	return -1;
 }
 
-void destroy_vertexbuffer(struct Graphics *graphics)
+int create_buffer(struct Graphics *graphics, VkDeviceSize size,
+		  VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+		  VkBuffer *buffer, struct allocation *allocation)
+{
+	VkBufferCreateInfo bufferInfo = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size,
+		.usage = usage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+	};
+
+	VkResult res = vkCreateBuffer(graphics->device, &bufferInfo, 0, buffer);
+
+	if(res != VK_SUCCESS)
+		goto buffer_create_error;
+
+	if(allocate_buffer_memory(graphics, *buffer, properties,
+				  allocation) == -1)
+		goto buffer_alloc_error;
+
+	return 0;
+buffer_alloc_error:
+	vkDestroyBuffer(graphics->device, *buffer, 0);
+buffer_create_error:
+	return -1;
+}
+
+void destroy_buffer(struct Graphics *graphics, VkBuffer buffer,
+		    struct allocation *allocation)
 {
-	vkDestroyBuffer(graphics->device, graphics->vertexbuffer, 0);
-	vkFreeMemory(graphics->device, graphics->vertex_buffer_memory, 0);
+	vkDestroyBuffer(graphics->device, buffer, 0);
+	free_memory(graphics, allocation);
 }
 
-int create_vertexbuffer(struct Graphics *graphics)
+VkCommandBuffer begin_onetime_commands(struct Graphics *graphics)
+{
+	VkCommandBuffer commandbuffer;
+
+	VkCommandBufferAllocateInfo allocInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = graphics->commandpool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1
+	};
+
+	VkResult res = vkAllocateCommandBuffers(graphics->device, &allocInfo,
+						&commandbuffer);
+
+	if(res != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	VkCommandBufferBeginInfo beginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+
+	res = vkBeginCommandBuffer(commandbuffer, &beginInfo);
+
+	if(res != VK_SUCCESS) {
+		vkFreeCommandBuffers(graphics->device, graphics->commandpool, 1,
+				     &commandbuffer);
+		return VK_NULL_HANDLE;
+	}
+
+	return commandbuffer;
+}
+
+/*
+ * submits one-time commands; with a timeline they signal the next value
+ * and are freed once it completes, otherwise the queue is drained. An
+ * async queue's last submission is waited for first when after is set.
+ */
+static int submit_onetime(struct Graphics *graphics,
+			  VkCommandBuffer commandbuffer,
+			  const struct async_queue *after,
+			  VkPipelineStageFlags stages)
+{
+	VkQueue queue = graphics->queues[queue_families_graphics];
+	struct timeline *timeline = &graphics->timeline;
+	uint64_t value = timeline_next(timeline);
+
+	VkResult res = vkEndCommandBuffer(commandbuffer);
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &value
+	};
+
+	VkSubmitInfo submitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &commandbuffer
+	};
+
+	if(timeline_enabled(timeline)) {
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &timeline->semaphore;
+	}
+
+	/* the fallback already drained the async queue */
+	if(after && after->semaphore != VK_NULL_HANDLE) {
+		timelineInfo.waitSemaphoreValueCount = 1;
+		timelineInfo.pWaitSemaphoreValues = &after->submitted;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &after->semaphore;
+		submitInfo.pWaitDstStageMask = &stages;
+	}
+
+	if(res == VK_SUCCESS)
+		res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+
+	if(res == VK_SUCCESS && timeline_enabled(timeline)) {
+		timeline_submitted(graphics);
+
+		struct timeline_garbage garbage = {
+			.commandpool = graphics->commandpool,
+			.commandbuffer = commandbuffer
+		};
+
+		if(timeline_defer(graphics, &garbage) == 0)
+			return 0;
+
+		timeline_wait(graphics, value);
+	} else if(res == VK_SUCCESS) {
+		res = vkQueueWaitIdle(queue);
+	}
+
+	vkFreeCommandBuffers(graphics->device, graphics->commandpool, 1,
+			     &commandbuffer);
+
+	return res == VK_SUCCESS ? 0 : -1;
+}
+
+int end_onetime_commands(struct Graphics *graphics,
+			 VkCommandBuffer commandbuffer)
+{
+	return submit_onetime(graphics, commandbuffer, 0, 0);
+}
+
+int end_onetime_commands_after(struct Graphics *graphics,
+			       VkCommandBuffer commandbuffer, int role,
+			       VkPipelineStageFlags stages)
+{
+	return submit_onetime(graphics, commandbuffer, graphics->async + role,
+			      stages);
+}
+
+static int graphics_upload(struct Graphics *graphics, VkBuffer staging,
+			   VkBuffer buffer, VkDeviceSize size)
+{
+	VkCommandBuffer commandbuffer = begin_onetime_commands(graphics);
+
+	if(commandbuffer == VK_NULL_HANDLE)
+		return -1;
+
+	VkBufferCopy region = {
+		.srcOffset = 0,
+		.dstOffset = 0,
+		.size = size
+	};
+
+	vkCmdCopyBuffer(commandbuffer, staging, buffer, 1, &region);
+
+	/* later submissions read it without waiting for this one */
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+				 VK_ACCESS_INDEX_READ_BIT
+	};
+
+	vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			     VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1,
+			     &barrier, 0, 0, 0, 0);
+
+	return end_onetime_commands(graphics, commandbuffer);
+}
+
+/*
+ * copies on the dedicated transfer queue while the graphics queue keeps
+ * rendering, then hands the buffer over to the graphics family in a
+ * submission that waits for the copy
+ */
+static int transfer_upload(struct Graphics *graphics, VkBuffer staging,
+			   VkBuffer buffer, VkDeviceSize size)
+{
+	struct async_queue *transfer = graphics->async + async_transfer;
+	uint32_t family =
+		graphics->queue_families.indices[queue_families_graphics];
+
+	VkCommandBuffer copy = async_begin(graphics, async_transfer);
+
+	if(copy == VK_NULL_HANDLE)
+		return -1;
+
+	VkBufferCopy region = {
+		.srcOffset = 0,
+		.dstOffset = 0,
+		.size = size
+	};
+
+	vkCmdCopyBuffer(copy, staging, buffer, 1, &region);
+
+	release_buffer(copy, buffer, transfer->family, family,
+		       VK_PIPELINE_STAGE_TRANSFER_BIT,
+		       VK_ACCESS_TRANSFER_WRITE_BIT);
+
+	if(async_submit(graphics, async_transfer, copy) == -1)
+		goto submit_error;
+
+	VkCommandBuffer acquire = begin_onetime_commands(graphics);
+
+	if(acquire == VK_NULL_HANDLE)
+		goto submit_error;
+
+	acquire_buffer(acquire, buffer, transfer->family, family,
+		       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		       VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+			       VK_ACCESS_INDEX_READ_BIT);
+
+	if(end_onetime_commands_after(graphics, acquire, async_transfer,
+				      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT) == -1)
+		goto submit_error;
+
+	struct timeline_garbage garbage = {
+		.commandpool = transfer->commandpool,
+		.commandbuffer = copy
+	};
+
+	/* the acquire waited for the copy, so its value covers both */
+	if(timeline_enabled(&graphics->timeline) &&
+	   timeline_defer(graphics, &garbage) == 0)
+		return 0;
+
+	timeline_wait(graphics, graphics->timeline.submitted);
+	vkFreeCommandBuffers(graphics->device, transfer->commandpool, 1, &copy);
+
+	return 0;
+
+submit_error:
+	vkQueueWaitIdle(transfer->queue);
+	vkFreeCommandBuffers(graphics->device, transfer->commandpool, 1, &copy);
+
+	return -1;
+}
+
+int upload_buffer(struct Graphics *graphics, VkBuffer buffer,
+		  const void *data, VkDeviceSize size)
 {
-	graphics->vertices = get_vertices(&graphics->vertices_n);
+	VkBuffer staging;
+	struct allocation staging_allocation;
+
+	int res = create_buffer(graphics, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+					VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&staging, &staging_allocation);
+
+	if(res == -1)
+		return -1;
+
+	memcpy(staging_allocation.mapped, data, size);
+
+	if(async_dedicated(graphics->async + async_transfer))
+		res = transfer_upload(graphics, staging, buffer, size);
+	else
+		res = graphics_upload(graphics, staging, buffer, size);
+
+	struct timeline_garbage garbage = {
+		.buffer = staging,
+		.allocation = staging_allocation
+	};
+
+	/* the copy may still be running when the timeline tracks it */
+	if(res == 0 && timeline_enabled(&graphics->timeline) &&
+	   timeline_defer(graphics, &garbage) == 0)
+		return 0;
 
-	pdebug("creating vertices: %d vertices", graphics->vertices_n);
+	timeline_wait(graphics, graphics->timeline.submitted);
+	destroy_buffer(graphics, staging, &staging_allocation);
 
+	return res;
+}
+
+/* whether a buffer like this can live in device local memory, -1 on error */
+static int device_local_supported(struct Graphics *graphics,
+				  VkBufferUsageFlags usage, VkDeviceSize size)
+{
 	VkBufferCreateInfo bufferInfo = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-		.size = (vertex_size() * graphics->vertices_n),
-		.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
+		.size = size,
+		.usage = usage,
 		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
 	};
 
-	VkResult res = vkCreateBuffer(graphics->device, &bufferInfo, 0,
-				      &graphics->vertexbuffer);
+	VkBuffer buffer;
+	VkMemoryRequirements requirements;
 
-	if(res != VK_SUCCESS)
-		goto buffer_create_error;
+	if(vkCreateBuffer(graphics->device, &bufferInfo, 0, &buffer) !=
+	   VK_SUCCESS)
+		return -1;
 
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(graphics->device, graphics->vertexbuffer,
-				      &memRequirements);
+	vkGetBufferMemoryRequirements(graphics->device, buffer, &requirements);
+	vkDestroyBuffer(graphics->device, buffer, 0);
 
-	int mem_type =
-		find_memory_type(graphics, memRequirements.memoryTypeBits,
-				 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-					 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	if(mem_type == -1)
-		goto buffer_alloc_error;
+	return find_memory_type(graphics, requirements.memoryTypeBits,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != -1;
+}
 
-	VkMemoryAllocateInfo allocInfo = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = memRequirements.size,
-		.memoryTypeIndex = mem_type
-	};
+/*
+ * device local buffer filled through a staging copy, or host visible memory
+ * written directly when the device has no separate device local memory
+ */
+int create_static_buffer(struct Graphics *graphics, VkBufferUsageFlags usage,
+			 const void *data, VkDeviceSize size, VkBuffer *buffer,
+			 struct allocation *allocation)
+{
+	usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-	res = vkAllocateMemory(graphics->device, &allocInfo, 0,
-			       &graphics->vertex_buffer_memory);
+	int res = device_local_supported(graphics, usage, size);
 
-	if(res != VK_SUCCESS)
-		goto buffer_alloc_error;
+	if(res == -1)
+		return -1;
+
+	if(res) {
+		/* out of device memory is an error, not a reason to fall back */
+		if(create_buffer(graphics, size, usage,
+				 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer,
+				 allocation) == -1)
+			return -1;
+
+		res = upload_buffer(graphics, *buffer, data, size);
+
+		if(res == -1)
+			destroy_buffer(graphics, *buffer, allocation);
 
-	vkBindBufferMemory(graphics->device, graphics->vertexbuffer,
-			   graphics->vertex_buffer_memory, 0);
+		return res;
+	}
 
-	void *data;
+	pdebug("no device local memory, buffer stays host visible");
 
-	vkMapMemory(graphics->device, graphics->vertex_buffer_memory, 0,
-		    bufferInfo.size, 0, &data);
-	memcpy(data, graphics->vertices, bufferInfo.size);
-	vkUnmapMemory(graphics->device, graphics->vertex_buffer_memory);
+	res = create_buffer(graphics, size, usage,
+			    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			    buffer, allocation);
+
+	if(res == -1)
+		return -1;
+
+	memcpy(allocation->mapped, data, size);
 
 	return 0;
-buffer_alloc_error:
-	vkDestroyBuffer(graphics->device, graphics->vertexbuffer, 0);
-buffer_create_error:
+}
+
+void destroy_vertexbuffer(struct Graphics *graphics)
+{
+	destroy_buffer(graphics, graphics->indexbuffer,
+		       &graphics->index_allocation);
+	destroy_buffer(graphics, graphics->vertexbuffer,
+		       &graphics->vertex_allocation);
+}
+
+int create_vertexbuffer(struct Graphics *graphics)
+{
+	struct mesh mesh;
+	uint32_t vertices_n;
+
+	const struct vertex *vertices = get_vertices(&vertices_n);
+
+	if(mesh_build(&mesh, vertices, vertices_n, vertex_size()) == -1)
+		goto mesh_build_error;
+
+	pdebug("creating vertices: %u vertices, %u indices", mesh.vertices_n,
+	       mesh.indices_n);
+
+	int res = create_static_buffer(graphics,
+				       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				       mesh.vertices,
+				       (VkDeviceSize) mesh.vertices_n *
+					       mesh.vertex_size,
+				       &graphics->vertexbuffer,
+				       &graphics->vertex_allocation);
+
+	if(res == -1)
+		goto vertexbuffer_error;
+
+	res = create_static_buffer(graphics, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+				   mesh.indices,
+				   (VkDeviceSize) mesh.indices_n *
+					   mesh.index_size,
+				   &graphics->indexbuffer,
+				   &graphics->index_allocation);
+
+	if(res == -1)
+		goto indexbuffer_error;
+
+	graphics->vertices_n = mesh.vertices_n;
+	graphics->indices_n = mesh.indices_n;
+	graphics->index_type = mesh.index_type;
+	vertex_bounds(vertices, vertices_n, graphics->mesh_center,
+		      &graphics->mesh_radius);
+
+	mesh_destroy(&mesh);
+
+	return 0;
+
+indexbuffer_error:
+	/* its upload may still be in flight */
+	timeline_wait(graphics, graphics->timeline.submitted);
+	timeline_collect(graphics, 0);
+	destroy_buffer(graphics, graphics->vertexbuffer,
+		       &graphics->vertex_allocation);
+vertexbuffer_error:
+	mesh_destroy(&mesh);
+mesh_build_error:
 	return -1;
 }
-static void destroy_swapchain(struct Graphics *graphics)
+static void destroy_retired(struct Graphics *graphics,
+			    struct retired_swapchain *retired)
 {
-	for (int i = 0; i < graphics->framebuffers_n; i++) {
-		vkDestroyFramebuffer(graphics->device, graphics->framebuffers[i], 0);
+	for(uint32_t i = 0; i < retired->views_n; i++) {
+		vkDestroyFramebuffer(graphics->device, retired->framebuffers[i], 0);
+		vkDestroyImageView(graphics->device, retired->imageviews[i], 0);
 	}
 
+	free(retired->framebuffers);
+	free(retired->imageviews);
 
-	for(int i = 0; i < graphics->imageviews_n; i++) {
-		vkDestroyImageView(graphics->device, graphics->imageviews[i], 0);
+	vkDestroySwapchainKHR(graphics->device, retired->swapchain, 0);
+}
+
+/*
+ * Destroys retired swapchains whose frames have all finished, or all of
+ * them when the device is idle. The presentation engine's own use of old
+ * images is not tracked by the timeline, but it is done with them before
+ * the frames after them complete.
+ */
+void release_retired_swapchains(struct Graphics *graphics, int idle)
+{
+	uint64_t completed = idle ? UINT64_MAX : timeline_completed(graphics);
+	uint32_t kept = 0;
+
+	for(uint32_t i = 0; i < graphics->retired_n; i++) {
+		struct retired_swapchain *retired = graphics->retired + i;
+
+		if(retired->value <= completed) {
+			destroy_retired(graphics, retired);
+			continue;
+		}
+
+		graphics->retired[kept++] = *retired;
 	}
 
-	vkDestroySwapchainKHR(graphics->device, graphics->swapchain, 0);
+	graphics->retired_n = kept;
+}
+
+/* hands the swapchain's views and framebuffers over to the retire list */
+static void retire_swapchain(struct Graphics *graphics)
+{
+	/* resizes outpacing the GPU, drain instead of growing the list */
+	if(graphics->retired_n == RETIRED_SWAPCHAINS_MAX) {
+		vkDeviceWaitIdle(graphics->device);
+		release_retired_swapchains(graphics, 1);
+	}
 
+	graphics->retired[graphics->retired_n++] = (struct retired_swapchain) {
+		.swapchain = graphics->swapchain,
+		.views_n = graphics->imageviews_n,
+		.imageviews = graphics->imageviews,
+		.framebuffers = graphics->framebuffers,
+		.value = graphics->timeline.submitted
+	};
+
+	graphics->imageviews = 0;
+	graphics->framebuffers = 0;
+	graphics->imageviews_n = 0;
+	graphics->framebuffers_n = 0;
 }
 
+/*
+ * Builds the new swapchain from the old one while frames using the old
+ * one are still in flight; the old one is destroyed once they retire
+ */
 int recreate_swapchain(struct Graphics *graphics)
 {
-	vkDeviceWaitIdle(graphics->device);
-	
-	destroy_swapchain(graphics);
+	VkSwapchainKHR old = graphics->swapchain;
+
+	/* a failed recreation leaves no swapchain, nothing to retire then */
+	if(old != VK_NULL_HANDLE)
+		retire_swapchain(graphics);
+
+	graphics->swapchain = VK_NULL_HANDLE;
 
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
 		graphics->physicalDevice, graphics->surface,
 		&graphics->swapchain_details.capabilities);
 
-	VkResult res = init_swapchain(graphics);
+	/* the old swapchain is retired even if this fails */
+	VkResult res = init_swapchain(graphics, old);
 
-	if(res != VK_SUCCESS)
+	if(res != VK_SUCCESS) {
 		pdebug("swapchain init error");
+		graphics->swapchain = VK_NULL_HANDLE;
+		goto swapchain_init_error;
+	}
 
 	uint32_t images_n;
 
@@ -169,89 +583,443 @@ int recreate_swapchain(struct Graphics *graphics)
 				&images_n, 0);
 
 	if(!images_n)
-		goto images_init_error;
+		goto images_malloc_error;
 
 	if(images_n != graphics->images_n) {
-		
-		free(graphics->images);	
-		free(graphics->imageviews);
-		free(graphics->framebuffers);
+		free(graphics->images);
 
 		graphics->images_n = images_n;
 		graphics->images = malloc(sizeof(VkImage) * graphics->images_n);
-		
+
 		if(!graphics->images)
 			goto images_malloc_error;
+	}
 
-		graphics->imageviews_n = images_n;
-		graphics->imageviews =
-			malloc(sizeof(VkImageView) * graphics->imageviews_n);
-
-		if(!graphics->imageviews)
-			goto imageviews_malloc_error;
+	graphics->imageviews = malloc(sizeof(VkImageView) * images_n);
 
-		graphics->framebuffers_n = images_n;
-		graphics->framebuffers = malloc(sizeof(VkFramebuffer) *
-						graphics->framebuffers_n);
+	if(!graphics->imageviews)
+		goto imageviews_malloc_error;
 
-		if(!graphics->framebuffers)
-			goto framebuffers_malloc_error;
-	}
+	graphics->framebuffers = malloc(sizeof(VkFramebuffer) * images_n);
 
+	if(!graphics->framebuffers)
+		goto framebuffers_malloc_error;
 
 	res = vkGetSwapchainImagesKHR(graphics->device, graphics->swapchain,
-				&graphics->images_n, graphics->images);
+				      &graphics->images_n, graphics->images);
 
 	if(res != VK_SUCCESS) {
 		pdebug("images init error");
 		goto images_init_error;
 	}
 
+	graphics->imageviews_n = images_n;
+
 	res = init_imageviews(graphics);
 
 	if(res != VK_SUCCESS) {
-		pdebug("images init error");
-		goto imageviews_init_error;
+		pdebug("imageviews init error");
+		goto images_init_error;
 	}
+
+	graphics->framebuffers_n = images_n;
+
 	res = init_framebufers(graphics);
 
 	if(res != VK_SUCCESS)
 		goto framebuffers_init_error;
-	
+
+	/* recordings reference the old framebuffers and extent */
+	graphics->scene_generation++;
+
 	return 0;
 
 framebuffers_init_error:
-imageviews_init_error:
 	for(int i = 0; i < graphics->imageviews_n; i++) {
 		vkDestroyImageView(graphics->device, graphics->imageviews[i], 0);
 	}
 
 images_init_error:
-framebuffers_malloc_error:
 	free(graphics->framebuffers);
-imageviews_malloc_error:
+framebuffers_malloc_error:
 	free(graphics->imageviews);
+imageviews_malloc_error:
 images_malloc_error:
+	/* nothing was acquired from it yet */
 	vkDestroySwapchainKHR(graphics->device, graphics->swapchain, 0);
+	graphics->swapchain = VK_NULL_HANDLE;
+swapchain_init_error:
 	free(graphics->images);
-
+	graphics->images = 0;
+	graphics->imageviews = 0;
+	graphics->framebuffers = 0;
 	graphics->images_n = 0;
 	graphics->framebuffers_n = 0;
 	graphics->imageviews_n = 0;
 
 	pdebug("recreation error");
-		
+
 	return -1;
 }
 
 
 
-int draw_frame(struct Graphics *graphics)
+static void read_timestamps(struct Graphics *graphics)
 {
-	vkWaitForFences(graphics->device, 1,
-			graphics->inflight_fences + graphics->current_frame,
+	uint32_t frame = graphics->current_frame;
+	uint64_t timestamps[timestamps_n];
+
+	if(!graphics->querypool || !graphics->queries_pending[frame])
+		return;
+
+	graphics->queries_pending[frame] = 0;
+
+	/* the frame's fence has signaled, so this never blocks */
+	VkResult res = vkGetQueryPoolResults(graphics->device,
+					     graphics->querypool,
+					     frame * timestamps_n, timestamps_n,
+					     sizeof(timestamps), timestamps,
+					     sizeof(uint64_t),
+					     VK_QUERY_RESULT_64_BIT);
+
+	if(res != VK_SUCCESS)
+		return;
+
+	uint64_t renderpass = (timestamps[timestamp_renderpass_end] -
+			       timestamps[timestamp_renderpass_begin]) &
+			      graphics->timestamp_mask;
+	uint64_t draw = (timestamps[timestamp_draw_end] -
+			 timestamps[timestamp_renderpass_begin]) &
+			graphics->timestamp_mask;
+
+	graphics->frame_stats.gpu_valid = 1;
+	graphics->frame_stats.gpu_renderpass_ns =
+		renderpass * graphics->timestamp_period;
+	graphics->frame_stats.gpu_draw_ns = draw * graphics->timestamp_period;
+}
+
+/*
+ * a cached recording is replayed from any frame slot, so the query slot
+ * baked into it would be wrong
+ */
+static inline int timestamps_enabled(const struct Graphics *graphics)
+{
+	return graphics->querypool &&
+	       !(graphics->flags & graphics_cached_commands_flag);
+}
+
+static void write_timestamp(struct Graphics *graphics,
+			    VkCommandBuffer commandbuffer,
+			    VkPipelineStageFlags stage, uint32_t timestamp)
+{
+	if(!timestamps_enabled(graphics))
+		return;
+
+	vkCmdWriteTimestamp(commandbuffer, stage, graphics->querypool,
+			    graphics->current_frame * timestamps_n + timestamp);
+}
+
+static inline void end_phase(struct Graphics *graphics, int phase,
+			     uint64_t *start)
+{
+	uint64_t now = timer_now_ns();
+
+	graphics->frame_stats.phase_ns[phase] = now - *start;
+	*start = now;
+}
+
+/* waits until the current frame slot's previous submission retired */
+static void wait_frame_slot(struct Graphics *graphics)
+{
+	struct timeline *timeline = &graphics->timeline;
+	uint32_t frame = graphics->current_frame;
+
+	if(timeline_enabled(timeline)) {
+		timeline_wait(graphics, timeline->frame_values[frame]);
+		return;
+	}
+
+	vkWaitForFences(graphics->device, 1, graphics->inflight_fences + frame,
 			VK_TRUE, UINT64_MAX);
-	if (graphics->flags & graphics_window_resized_flag) {
+
+	if(timeline->frame_values[frame] > timeline->completed)
+		timeline->completed = timeline->frame_values[frame];
+}
+
+/*
+ * the fence fallback rearms the slot's fence right before submitting, so
+ * a frame that fails before it leaves the fence signalled for the next
+ */
+static void reset_frame_slot(struct Graphics *graphics)
+{
+	if(!timeline_enabled(&graphics->timeline))
+		vkResetFences(graphics->device, 1,
+			      graphics->inflight_fences + graphics->current_frame);
+}
+
+/* submits a frame signalling its timeline value, or its slot's fence */
+static VkResult submit_frame(struct Graphics *graphics,
+			     VkSubmitInfo *submitInfo)
+{
+	struct timeline *timeline = &graphics->timeline;
+	VkQueue queue = graphics->queues[queue_families_graphics];
+
+	if(!timeline_enabled(timeline))
+		return vkQueueSubmit(queue, 1, submitInfo,
+				     graphics->inflight_fences[graphics->current_frame]);
+
+	/* at most one binary semaphore each way, whose values are ignored */
+	uint32_t binary_n = submitInfo->signalSemaphoreCount;
+	uint32_t waits_n = submitInfo->waitSemaphoreCount;
+	VkSemaphore waits[1 + async_queues_n];
+	uint64_t wait_values[1 + async_queues_n] = {0};
+	VkPipelineStageFlags wait_stages[1 + async_queues_n];
+
+	if(waits_n) {
+		waits[0] = submitInfo->pWaitSemaphores[0];
+		wait_stages[0] = submitInfo->pWaitDstStageMask[0];
+	}
+
+	/* async work this frame consumes, e.g. a compute pass */
+	waits_n += async_frame_waits(graphics, waits + waits_n,
+				     wait_values + waits_n,
+				     wait_stages + waits_n);
+
+	VkSemaphore semaphores[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+	uint64_t values[2] = {0, 0};
+
+	if(binary_n)
+		semaphores[0] = submitInfo->pSignalSemaphores[0];
+
+	semaphores[binary_n] = timeline->semaphore;
+	values[binary_n] = timeline_next(timeline);
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.waitSemaphoreValueCount = waits_n,
+		.pWaitSemaphoreValues = wait_values,
+		.signalSemaphoreValueCount = binary_n + 1,
+		.pSignalSemaphoreValues = values
+	};
+
+	submitInfo->pNext = &timelineInfo;
+	submitInfo->waitSemaphoreCount = waits_n;
+	submitInfo->pWaitSemaphores = waits;
+	submitInfo->pWaitDstStageMask = wait_stages;
+	submitInfo->signalSemaphoreCount = binary_n + 1;
+	submitInfo->pSignalSemaphores = semaphores;
+
+	return vkQueueSubmit(queue, 1, submitInfo, VK_NULL_HANDLE);
+}
+
+/* bookkeeping for the frame just submitted from the current frame slot */
+static void frame_submitted(struct Graphics *graphics)
+{
+	struct timeline *timeline = &graphics->timeline;
+	uint64_t value = timeline_next(timeline);
+
+	if(timestamps_enabled(graphics))
+		graphics->queries_pending[graphics->current_frame] = 1;
+
+	timeline->frame_values[graphics->current_frame] = value;
+
+	stream_submitted(graphics, value);
+
+	/* cached frames neither copy nor draw chunks */
+	if(graphics->chunkstream &&
+	   !(graphics->flags & graphics_cached_commands_flag))
+		chunkstream_submitted(graphics, value);
+
+	timeline_submitted(graphics);
+}
+
+static int resize_image_commandbuffers(struct Graphics *graphics)
+{
+	uint32_t images_n = graphics->images_n;
+
+	if(graphics->image_commandbuffers_n) {
+		uint64_t last = 0;
+
+		/* recreation no longer drains the GPU, recordings may be pending */
+		for(uint32_t i = 0; i < graphics->image_commandbuffers_n; i++) {
+			if(graphics->image_values[i] > last)
+				last = graphics->image_values[i];
+		}
+
+		timeline_wait(graphics, last);
+
+		vkFreeCommandBuffers(graphics->device, graphics->commandpool,
+				     graphics->image_commandbuffers_n,
+				     graphics->image_commandbuffers);
+		graphics->image_commandbuffers_n = 0;
+	}
+
+	free(graphics->image_commandbuffers);
+	free(graphics->image_generations);
+	free(graphics->image_values);
+
+	graphics->image_commandbuffers = malloc(sizeof(VkCommandBuffer) * images_n);
+	graphics->image_generations = malloc(sizeof(uint64_t) * images_n);
+	graphics->image_values = calloc(images_n, sizeof(uint64_t));
+
+	if(!graphics->image_commandbuffers || !graphics->image_generations ||
+	   !graphics->image_values)
+		return -1;
+
+	VkCommandBufferAllocateInfo allocInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = graphics->commandpool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = images_n
+	};
+
+	VkResult res = vkAllocateCommandBuffers(graphics->device, &allocInfo,
+						graphics->image_commandbuffers);
+
+	if(res != VK_SUCCESS)
+		return -1;
+
+	graphics->image_commandbuffers_n = images_n;
+
+	/* generations only grow, so this forces a first recording */
+	for(uint32_t i = 0; i < images_n; i++)
+		graphics->image_generations[i] = graphics->scene_generation - 1;
+
+	return 0;
+}
+
+/*
+ * returns the recorded command buffer to submit for image_i, called after
+ * the current frame slot's previous submission has retired
+ */
+static VkCommandBuffer get_commandbuffer(struct Graphics *graphics,
+					 uint32_t image_i)
+{
+	VkCommandBuffer commandbuffer;
+
+	descriptors_frame_reset(graphics);
+
+	if(sync_instances(graphics) == -1)
+		return VK_NULL_HANDLE;
+
+	if(uniforms_prepare(graphics) == -1)
+		return VK_NULL_HANDLE;
+
+	if(cull_active(graphics) && cull_prepare(graphics) == -1)
+		return VK_NULL_HANDLE;
+
+	if(graphics->chunkstream &&
+	   !(graphics->flags & graphics_cached_commands_flag) &&
+	   chunkstream_prepare(graphics) == -1)
+		return VK_NULL_HANDLE;
+
+	if(graphics->particles &&
+	   !(graphics->flags & graphics_cached_commands_flag) &&
+	   particles_prepare(graphics) == -1)
+		return VK_NULL_HANDLE;
+
+	if(!(graphics->flags & graphics_cached_commands_flag)) {
+		commandbuffer = graphics->commandbuffers[graphics->current_frame];
+
+		vkResetCommandBuffer(commandbuffer, 0);
+
+		if(record_commandbuffer(graphics, commandbuffer, image_i) == -1)
+			return VK_NULL_HANDLE;
+
+		return commandbuffer;
+	}
+
+	if(graphics->image_commandbuffers_n != graphics->images_n &&
+	   resize_image_commandbuffers(graphics) == -1)
+		return VK_NULL_HANDLE;
+
+	commandbuffer = graphics->image_commandbuffers[image_i];
+
+	/* the recording may still be pending from another frame slot */
+	if(timeline_wait(graphics, graphics->image_values[image_i]) == -1)
+		return VK_NULL_HANDLE;
+
+	graphics->image_values[image_i] = timeline_next(&graphics->timeline);
+
+	if(graphics->image_generations[image_i] == graphics->scene_generation)
+		return commandbuffer;
+
+	if(record_commandbuffer(graphics, commandbuffer, image_i) == -1)
+		return VK_NULL_HANDLE;
+
+	graphics->image_generations[image_i] = graphics->scene_generation;
+
+	return commandbuffer;
+}
+
+static int draw_offscreen_frame(struct Graphics *graphics)
+{
+	uint64_t start = timer_now_ns();
+
+	wait_frame_slot(graphics);
+
+	end_phase(graphics, graphics_phase_fence_wait, &start);
+
+	read_timestamps(graphics);
+	timeline_collect(graphics, 0);
+
+	/* the offscreen ring has one target per frame in flight */
+	VkCommandBuffer commandbuffer =
+		get_commandbuffer(graphics, graphics->current_frame);
+
+	if(commandbuffer == VK_NULL_HANDLE) {
+		pdebug("record buffer error");
+		return -1;
+	}
+
+	end_phase(graphics, graphics_phase_record, &start);
+
+	VkSubmitInfo submitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &commandbuffer
+	};
+
+	reset_frame_slot(graphics);
+
+	VkResult res = submit_frame(graphics, &submitInfo);
+
+	if(res != VK_SUCCESS)
+		return -1;
+
+	end_phase(graphics, graphics_phase_submit, &start);
+
+	frame_submitted(graphics);
+
+	graphics->current_frame =
+		(graphics->current_frame + 1) % graphics->frames_inflight;
+
+	return 0;
+}
+
+int draw_frame(struct Graphics *graphics)
+{
+	memset(&graphics->frame_stats, 0, sizeof(graphics->frame_stats));
+
+	if(graphics->flags & graphics_headless_flag)
+		return draw_offscreen_frame(graphics);
+
+	uint64_t start = timer_now_ns();
+
+	wait_frame_slot(graphics);
+
+	end_phase(graphics, graphics_phase_fence_wait, &start);
+
+	read_timestamps(graphics);
+
+	timeline_collect(graphics, 0);
+
+	if(graphics->retired_n)
+		release_retired_swapchains(graphics, 0);
+
+	/* also retries after a failed recreation, e.g. while minimized */
+	if((graphics->flags & graphics_window_resized_flag) ||
+	   graphics->swapchain == VK_NULL_HANDLE) {
 		graphics->flags &= ~graphics_window_resized_flag;
 		goto swapchain_out_of_date;
 	}
@@ -262,32 +1030,29 @@ int draw_frame(struct Graphics *graphics)
 		graphics->image_available_semaphores[graphics->current_frame],
 		VK_NULL_HANDLE, &image_i);
 
+	end_phase(graphics, graphics_phase_acquire, &start);
+
 	if (res == VK_ERROR_OUT_OF_DATE_KHR) {
 		goto swapchain_out_of_date;
 	}
 
+	/*
+	 * a stale swapchain keeps presenting, scaled, until the window
+	 * reports a settled size through graphics_window_resized
+	 */
 	if(res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
 		return -1;
 	}
 
-	vkResetFences(graphics->device, 1,
-		      graphics->inflight_fences + graphics->current_frame);
-
-
+	VkCommandBuffer commandbuffer = get_commandbuffer(graphics, image_i);
 
-	vkResetCommandBuffer(graphics->commandbuffers[graphics->current_frame],
-			     0);
-
-
-	int r = record_commandbuffer(graphics,
-			     graphics->commandbuffers[graphics->current_frame],
-			     image_i);
-
-	if(r == -1) {
+	if(commandbuffer == VK_NULL_HANDLE) {
 		pdebug("record buffer error");
 		return -1;
 	}
 
+	end_phase(graphics, graphics_phase_record, &start);
+
 	VkPipelineStageFlags wait_stages[] = {
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
 	};
@@ -299,17 +1064,17 @@ int draw_frame(struct Graphics *graphics)
 				   graphics->current_frame,
 		.pWaitDstStageMask = wait_stages,
 		.commandBufferCount = 1,
-		.pCommandBuffers =
-			graphics->commandbuffers + graphics->current_frame,
+		.pCommandBuffers = &commandbuffer,
 		.signalSemaphoreCount = 1,
 		.pSignalSemaphores = graphics->render_finished_semaphores +
 				     graphics->current_frame
 	};
 
-	res = vkQueueSubmit(
-		graphics->queues[queue_families_graphics], 1, &submitInfo,
-		graphics->inflight_fences[graphics->current_frame]);
+	reset_frame_slot(graphics);
 
+	res = submit_frame(graphics, &submitInfo);
+
+	end_phase(graphics, graphics_phase_submit, &start);
 
 	if(res == VK_ERROR_OUT_OF_DATE_KHR) {
 		goto swapchain_out_of_date;
@@ -319,6 +1084,8 @@ int draw_frame(struct Graphics *graphics)
 		return -1;
 	}
 
+	frame_submitted(graphics);
+
 
 	VkPresentInfoKHR presentInfo = {
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -335,11 +1102,13 @@ int draw_frame(struct Graphics *graphics)
 	res = vkQueuePresentKHR(graphics->queues[queue_families_present],
 				&presentInfo);
 
+	end_phase(graphics, graphics_phase_present, &start);
+
 	if(res == VK_ERROR_OUT_OF_DATE_KHR) {
 		goto swapchain_out_of_date;
 	}
 
-	if(res != VK_SUCCESS) {
+	if(res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
 		return -1;
 
 	}
@@ -350,7 +1119,16 @@ int draw_frame(struct Graphics *graphics)
 	return 0;
 
 swapchain_out_of_date:
-	return recreate_swapchain(graphics);
+	/* the draws were queued for this frame only */
+	stream_discard(graphics);
+
+	start = timer_now_ns();
+
+	int recreated = recreate_swapchain(graphics);
+
+	end_phase(graphics, graphics_phase_recreate, &start);
+
+	return recreated;
 }
 
 
@@ -391,7 +1169,7 @@ int create_syncobjects(struct Graphics *graphics)
 		goto render_finished_semaphores_malloc_error;
 
 	graphics->inflight_fences =
-		malloc(sizeof(VkFence) * graphics->frames_inflight);
+		calloc(graphics->frames_inflight, sizeof(VkFence));
 
 	if(!graphics->inflight_fences)
 		goto inflight_fences_malloc_error;
@@ -422,7 +1200,11 @@ int create_syncobjects(struct Graphics *graphics)
 
 	}
 
-	for(k = 0; k < graphics->frames_inflight; k++) {
+	/* the timeline tracks frames instead */
+	uint32_t fences_n = graphics->flags & graphics_timeline_flag ?
+				    0 : graphics->frames_inflight;
+
+	for(k = 0; k < fences_n; k++) {
 		VkResult res = vkCreateFence(graphics->device, &fenceInfo, 0,
 			    graphics->inflight_fences + k);
 
@@ -463,6 +1245,149 @@ image_available_semaphores_malloc_error:
 	return -1;
 }
 
+void destroy_querypool(struct Graphics *graphics)
+{
+	if(!graphics->querypool)
+		return;
+
+	vkDestroyQueryPool(graphics->device, graphics->querypool, 0);
+	free(graphics->queries_pending);
+}
+
+int create_querypool(struct Graphics *graphics)
+{
+	uint32_t families_n;
+	uint32_t family = graphics->queue_families.indices[queue_families_graphics];
+
+	graphics->querypool = VK_NULL_HANDLE;
+
+	vkGetPhysicalDeviceQueueFamilyProperties(graphics->physicalDevice,
+						 &families_n, 0);
+
+	VkQueueFamilyProperties *families =
+		malloc(sizeof(VkQueueFamilyProperties) * families_n);
+
+	if(!families)
+		return -1;
+
+	vkGetPhysicalDeviceQueueFamilyProperties(graphics->physicalDevice,
+						 &families_n, families);
+
+	uint32_t valid_bits = families[family].timestampValidBits;
+
+	free(families);
+
+	if(!valid_bits) {
+		pdebug("timestamps unsupported, gpu stats disabled");
+		return 0;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(graphics->physicalDevice, &properties);
+
+	graphics->timestamp_period = properties.limits.timestampPeriod;
+	graphics->timestamp_mask =
+		valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+
+	graphics->queries_pending =
+		calloc(graphics->frames_inflight, sizeof(uint32_t));
+
+	if(!graphics->queries_pending)
+		return -1;
+
+	VkQueryPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = graphics->frames_inflight * timestamps_n
+	};
+
+	VkResult res = vkCreateQueryPool(graphics->device, &poolInfo, 0,
+					 &graphics->querypool);
+
+	if(res != VK_SUCCESS) {
+		graphics->querypool = VK_NULL_HANDLE;
+		free(graphics->queries_pending);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * records slice part of parts_n of the scene's instances, which must land in
+ * the render pass; the last slice also marks the end of drawing
+ */
+void record_scene(struct Graphics *graphics, VkCommandBuffer commandbuffer,
+		  uint32_t part, uint32_t parts_n)
+{
+	vkCmdBindPipeline(commandbuffer,
+			  VK_PIPELINE_BIND_POINT_GRAPHICS, graphics->pipeline);
+	bind_uniforms(graphics, commandbuffer);
+	bind_textures(graphics, commandbuffer);
+
+	VkBuffer buffers[vertex_bindings_n] = {
+		[vertex_binding_vertex] = graphics->vertexbuffer,
+		[vertex_binding_instance] = graphics->instancebuffer
+	};
+
+	VkDeviceSize offsets[vertex_bindings_n] = {
+		[vertex_binding_vertex] = 0,
+		[vertex_binding_instance] = instance_region_offset(graphics)
+	};
+
+	vkCmdBindVertexBuffers(commandbuffer, 0, vertex_bindings_n, buffers,
+			       offsets);
+	vkCmdBindIndexBuffer(commandbuffer, graphics->indexbuffer, 0,
+			     graphics->index_type);
+
+	VkViewport viewport = {
+		.x = 0,
+		.y = 0,
+		.width = graphics->swapchain_extent.width,
+		.height = graphics->swapchain_extent.height,
+		.minDepth = 0,
+		.maxDepth = 0
+	};
+
+	VkRect2D scissor = {
+		.offset = {0, 0},
+		.extent = graphics->swapchain_extent
+	};
+
+	vkCmdSetViewport(commandbuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandbuffer, 0, 1, &scissor);
+
+	/* instance counts dwarf vertex counts, so split the instances */
+	uint32_t first = (uint64_t) graphics->instances_n * part / parts_n;
+	uint32_t last = (uint64_t) graphics->instances_n * (part + 1) / parts_n;
+
+	/* the culling pass wrote every instance's draw, part 0 issues them */
+	if(cull_active(graphics)) {
+		if(!part)
+			record_cull_draws(graphics, commandbuffer);
+	} else if(last > first) {
+		vkCmdDrawIndexed(commandbuffer, graphics->indices_n,
+				 last - first, 0, 0, first);
+	}
+
+	if(part != parts_n - 1)
+		return;
+
+	if(!(graphics->flags & graphics_cached_commands_flag)) {
+		if(graphics->chunkstream)
+			record_chunks(graphics, commandbuffer);
+
+		record_stream(graphics, commandbuffer);
+
+		if(graphics->particles)
+			record_particles(graphics, commandbuffer);
+	}
+
+	write_timestamp(graphics, commandbuffer,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			timestamp_draw_end);
+}
+
 int record_commandbuffer(struct Graphics *graphics,
 			 VkCommandBuffer commandbuffer, uint32_t image_i)
 {
@@ -477,6 +1402,11 @@ int record_commandbuffer(struct Graphics *graphics,
 	if(res != VK_SUCCESS)
 		return -1;
 
+	if(timestamps_enabled(graphics))
+		vkCmdResetQueryPool(commandbuffer, graphics->querypool,
+				    graphics->current_frame * timestamps_n,
+				    timestamps_n);
+
 	VkClearValue clearColor = {
 		.color = {0, 0, 0, 0}
 	};
@@ -490,40 +1420,60 @@ int record_commandbuffer(struct Graphics *graphics,
 			.extent = graphics->swapchain_extent
 		},
 
-		.clearValueCount = 1,
-		.pClearValues = &clearColor
-	};
+		.clearValueCount = 1,
+		.pClearValues = &clearColor
+	};
+
+	/* cached recordings are replayed as a whole, keep them inline */
+	int threaded = graphics->workers &&
+		       !(graphics->flags & graphics_cached_commands_flag);
+
+	if(threaded)
+		workers_begin(graphics->workers, image_i);
+
+	/* compute has to stay outside the render pass */
+	if(graphics->particles &&
+	   !(graphics->flags & graphics_cached_commands_flag))
+		record_particles_step(graphics, commandbuffer);
+
+	if(graphics->chunkstream &&
+	   !(graphics->flags & graphics_cached_commands_flag))
+		record_chunk_uploads(graphics, commandbuffer);
 
-	vkCmdBeginRenderPass(commandbuffer, &renderPassInfo,
-			     VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(commandbuffer,
-			  VK_PIPELINE_BIND_POINT_GRAPHICS, graphics->pipeline);
+	if(cull_active(graphics))
+		record_cull(graphics, commandbuffer);
 
-	VkDeviceSize offsets[] = {0};
+	write_timestamp(graphics, commandbuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			timestamp_renderpass_begin);
 
-	vkCmdBindVertexBuffers(commandbuffer, 0, 1, &graphics->vertexbuffer,
-			       offsets);
+	if(!threaded) {
+		vkCmdBeginRenderPass(commandbuffer, &renderPassInfo,
+				     VK_SUBPASS_CONTENTS_INLINE);
 
-	VkViewport viewport = {
-		.x = 0,
-		.y = 0,
-		.width = graphics->swapchain_extent.width,
-		.height = graphics->swapchain_extent.height,
-		.minDepth = 0,
-		.maxDepth = 0
-	};
+		record_scene(graphics, commandbuffer, 0, 1);
+	} else {
+		vkCmdBeginRenderPass(
+			commandbuffer, &renderPassInfo,
+			VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-	VkRect2D scissor = {
-		.offset = {0, 0},
-		.extent = graphics->swapchain_extent
-	};
+		const VkCommandBuffer *secondaries =
+			workers_wait(graphics->workers);
 
-	vkCmdSetViewport(commandbuffer, 0, 1, &viewport);
-	vkCmdSetScissor(commandbuffer, 0, 1, &scissor);
+		/* the next reset discards the half recorded buffer */
+		if(!secondaries)
+			return -1;
+
+		vkCmdExecuteCommands(commandbuffer,
+				     graphics->workers->workers_n, secondaries);
+	}
 
-	vkCmdDraw(commandbuffer, graphics->vertices_n, 1, 0, 0);
 	vkCmdEndRenderPass(commandbuffer);
 
+	write_timestamp(graphics, commandbuffer,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			timestamp_renderpass_end);
+
 	res = vkEndCommandBuffer(commandbuffer);
 
 	if(res != VK_SUCCESS)
@@ -555,6 +1505,14 @@ int create_commandbuffers(struct Graphics *graphics)
 
 	return 0;
 }
+void destroy_commandbuffers(struct Graphics *graphics)
+{
+	free(graphics->commandbuffers);
+	free(graphics->image_commandbuffers);
+	free(graphics->image_generations);
+	free(graphics->image_values);
+}
+
 int create_commandpool(struct Graphics *graphics)
 {
 	VkCommandPoolCreateInfo poolInfo = {
@@ -595,7 +1553,7 @@ static VkResult init_framebufers(struct Graphics *graphics)
 		
 		for(int j = 0; j < i; j++) {
 			vkDestroyFramebuffer(graphics->device,
-					     graphics->framebuffers[i], 0);
+					     graphics->framebuffers[j], 0);
 		}
 
 
@@ -641,6 +1599,9 @@ int create_renderpass(struct Graphics *graphics)
 		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
 	};
 
+	if(graphics->flags & graphics_headless_flag)
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
 
 	VkAttachmentReference colorAttachmentRef = {
 		.attachment = 0,
@@ -680,21 +1641,15 @@ int create_renderpass(struct Graphics *graphics)
 
 	return 0;
 }
-int create_pipeline(struct Graphics *graphics)
+/*
+ * a pipeline drawing into the scene's renderpass with its fixed function
+ * state and graphics->pipeline_layout, dynamic viewport and scissor
+ */
+int create_graphics_pipeline(struct Graphics *graphics,
+			     const VkPipelineShaderStageCreateInfo *shader_stages,
+			     const VkPipelineVertexInputStateCreateInfo *vertexInputInfo,
+			     VkPrimitiveTopology topology, VkPipeline *pipeline)
 {
-	VkPipelineShaderStageCreateInfo shader_stages[shaders_n];
-
-	for (int i = 0; i < shaders_n; i++) {
-		shader_stages[i] = (VkPipelineShaderStageCreateInfo) {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.module = graphics->shadermodules[i],
-			.pName = "main"
-		};
-	}
-
-	shader_stages[fragment_shader].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	shader_stages[vertex_shader].stage = VK_SHADER_STAGE_VERTEX_BIT;
-
 	VkDynamicState dynamic_states[2] = {
 		VK_DYNAMIC_STATE_VIEWPORT,
     		VK_DYNAMIC_STATE_SCISSOR
@@ -706,27 +1661,9 @@ int create_pipeline(struct Graphics *graphics)
 		.pDynamicStates = dynamic_states
 	};
 
-	uint32_t attribute_descriptions_n;
-
-	const VkVertexInputAttributeDescription *attribute_descriptions =
-		vertex_vkattribute_descriptions(
-			&attribute_descriptions_n);
-
-	uint32_t binding_decriptions_n;
-	const VkVertexInputBindingDescription *binding_descriptions = 
-		vertex_vkbinding_descriptions(&binding_decriptions_n);
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		.vertexBindingDescriptionCount = binding_decriptions_n,
-		.pVertexBindingDescriptions = binding_descriptions,
-		.vertexAttributeDescriptionCount = attribute_descriptions_n,
-		.pVertexAttributeDescriptions = attribute_descriptions
-	};
-
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		.topology = topology,
 		.primitiveRestartEnable = VK_FALSE
 	};
 
@@ -800,26 +1737,11 @@ int create_pipeline(struct Graphics *graphics)
 		}
 	};
 
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-		.setLayoutCount = 0,
-		.pSetLayouts = 0,
-		.pushConstantRangeCount = 0,
-		.pPushConstantRanges = 0
-	};
-
-	VkResult res = vkCreatePipelineLayout(graphics->device,
-					      &pipelineLayoutInfo, 0,
-					      &graphics->pipeline_layout);
-
-	if(res != VK_SUCCESS)
-		return -1;
-
 	VkGraphicsPipelineCreateInfo pipelineInfo = {
 		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
 		.stageCount = 2,
 		.pStages = shader_stages,
-		.pVertexInputState = &vertexInputInfo,
+		.pVertexInputState = vertexInputInfo,
 		.pInputAssemblyState = &inputAssembly,
 		.pViewportState = &viewportState,
 		.pRasterizationState = &rasterizer,
@@ -834,15 +1756,109 @@ int create_pipeline(struct Graphics *graphics)
 		.basePipelineIndex = -1
 	};
 
-	res = vkCreateGraphicsPipelines(graphics->device, VK_NULL_HANDLE, 1,
-					&pipelineInfo, 0, &graphics->pipeline);
+	VkResult res = vkCreateGraphicsPipelines(graphics->device,
+						 graphics->pipelinecache, 1,
+						 &pipelineInfo, 0, pipeline);
 
-	if(res != VK_SUCCESS) {
-		vkDestroyPipelineLayout(graphics->device, graphics->pipeline_layout, 0);
+	return res == VK_SUCCESS ? 0 : -1;
+}
+int create_pipeline(struct Graphics *graphics)
+{
+	VkPipelineShaderStageCreateInfo shader_stages[shaders_n];
+
+	for (int i = 0; i < shaders_n; i++) {
+		shader_stages[i] = (VkPipelineShaderStageCreateInfo) {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.module = graphics->shadermodules[i],
+			.pName = "main"
+		};
+	}
+
+	shader_stages[fragment_shader].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shader_stages[vertex_shader].stage = VK_SHADER_STAGE_VERTEX_BIT;
+
+	uint32_t attribute_descriptions_n;
+
+	const VkVertexInputAttributeDescription *attribute_descriptions =
+		vertex_vkattribute_descriptions(
+			&attribute_descriptions_n);
+
+	uint32_t binding_decriptions_n;
+	const VkVertexInputBindingDescription *binding_descriptions = 
+		vertex_vkbinding_descriptions(&binding_decriptions_n);
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.vertexBindingDescriptionCount = binding_decriptions_n,
+		.pVertexBindingDescriptions = binding_descriptions,
+		.vertexAttributeDescriptionCount = attribute_descriptions_n,
+		.pVertexAttributeDescriptions = attribute_descriptions
+	};
+
+	VkPushConstantRange pushRange = {
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.offset = 0,
+		.size = sizeof(struct draw_constants)
+	};
+
+	/* set 1 is the bindless texture array, when there is one */
+	VkDescriptorSetLayout set_layouts[2] = {graphics->uniforms.set_layout};
+
+	if(textures_layout(graphics, set_layouts + 1) == -1)
+		return -1;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = set_layouts[1] != VK_NULL_HANDLE ? 2 : 1,
+		.pSetLayouts = set_layouts,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushRange
+	};
+
+	VkResult res = vkCreatePipelineLayout(graphics->device,
+					      &pipelineLayoutInfo, 0,
+					      &graphics->pipeline_layout);
+
+	if(res != VK_SUCCESS)
 		return -1;
+
+	VkShaderModule textured = VK_NULL_HANDLE;
+
+	if(set_layouts[1] != VK_NULL_HANDLE) {
+		VkShaderModuleCreateInfo moduleInfo = {
+			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			.codeSize = textured_frag_spv_size,
+			.pCode = textured_frag_spv
+		};
+
+		res = vkCreateShaderModule(graphics->device, &moduleInfo, 0,
+					   &textured);
+
+		if(res != VK_SUCCESS)
+			goto module_create_error;
+
+		shader_stages[fragment_shader].module = textured;
 	}
 
+	int ret = create_graphics_pipeline(graphics, shader_stages,
+					   &vertexInputInfo,
+					   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+					   &graphics->pipeline);
+
+	/* the pipeline no longer needs the module */
+	if(textured != VK_NULL_HANDLE)
+		vkDestroyShaderModule(graphics->device, textured, 0);
+
+	if(ret == -1)
+		goto pipeline_create_error;
+
 	return 0;
+
+pipeline_create_error:
+module_create_error:
+	vkDestroyPipelineLayout(graphics->device, graphics->pipeline_layout, 0);
+
+	return -1;
 }
 int create_shadermodules(struct Graphics *graphics)
 {
@@ -850,7 +1866,7 @@ int create_shadermodules(struct Graphics *graphics)
 		VkShaderModuleCreateInfo createInfo = {
 			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
 			.codeSize = graphics->shader_sizes[i],
-			.pCode = (const uint32_t *) graphics->shaders[i]
+			.pCode = graphics->shaders[i]
 		};
 
 		VkResult res =
@@ -861,7 +1877,7 @@ int create_shadermodules(struct Graphics *graphics)
 			continue;
 
 		for(int j = 0; j < i; j++) {
-			vkDestroyShaderModule(graphics->device, graphics->shadermodules[i], 0);
+			vkDestroyShaderModule(graphics->device, graphics->shadermodules[j], 0);
 		}
 
 		return -1;
@@ -870,37 +1886,6 @@ int create_shadermodules(struct Graphics *graphics)
 	return 0;
 }
 
-char *read_binary_file(const char *filename, size_t *size)
-{
-	
-	FILE *fp = fopen(filename, "rb");
-
-	if(!fp) {
-		pdebug("%s not found", filename);
-		return 0;
-	}
-
-	fseek(fp, 0, SEEK_END);
-
-	*size = ftell(fp);
-
-	if(!*size) {
-		return 0;
-	}
-
-	char *buffer = malloc(sizeof(char *) * *size);
-	
-	if(!buffer) {
-		return 0;
-	}
-
-	fseek(fp, 0, SEEK_SET);
-
-	fread(buffer, 1, *size, fp);
-
-	return buffer;
-}
-
 void swapchain_details_destroy(struct swapchain_details *swapchain_details)
 {
 	free(swapchain_details->formats);
@@ -974,7 +1959,8 @@ int create_imageviews(struct Graphics *graphics)
 }
 
 
-static VkResult init_swapchain(struct Graphics *graphics)
+static VkResult init_swapchain(struct Graphics *graphics,
+				VkSwapchainKHR old)
 {
 	VkSurfaceFormatKHR format = get_format(&graphics->swapchain_details);
 		
@@ -982,7 +1968,7 @@ static VkResult init_swapchain(struct Graphics *graphics)
 		.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
 		.surface = graphics->surface,
 
-		.minImageCount = get_images_n(&graphics->swapchain_details),
+		.minImageCount = get_images_n(graphics),
 		.imageFormat = format.format,
 		.imageColorSpace = format.colorSpace,
 		.imageExtent = get_swapextent(&graphics->swapchain_details),
@@ -993,9 +1979,9 @@ static VkResult init_swapchain(struct Graphics *graphics)
 		.preTransform = graphics->swapchain_details.capabilities.currentTransform,
 		.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
 
-		.presentMode = get_presentmode(&graphics->swapchain_details),
+		.presentMode = get_presentmode(graphics),
 		.clipped = VK_TRUE,
-		.oldSwapchain = VK_NULL_HANDLE
+		.oldSwapchain = old
 	};
 
 	if (graphics->queue_families.indices[queue_families_graphics] !=
@@ -1021,7 +2007,7 @@ static VkResult init_swapchain(struct Graphics *graphics)
 
 int create_swapchain(struct Graphics *graphics)
 {
-	VkResult res = init_swapchain(graphics);
+	VkResult res = init_swapchain(graphics, VK_NULL_HANDLE);
 
 	if(res != VK_SUCCESS)
 		return -1;
@@ -1043,6 +2029,94 @@ int create_swapchain(struct Graphics *graphics)
 	return 0;
 }
 
+void destroy_offscreen_images(struct Graphics *graphics)
+{
+	for(int i = 0; i < graphics->images_n; i++) {
+		vkDestroyImage(graphics->device, graphics->images[i], 0);
+		free_memory(graphics, graphics->image_allocations + i);
+	}
+
+	free(graphics->image_allocations);
+	free(graphics->images);
+}
+
+int create_offscreen_images(struct Graphics *graphics)
+{
+	int i;
+
+	graphics->swapchain_format = VK_FORMAT_R8G8B8A8_UNORM;
+	graphics->images_n = graphics->frames_inflight;
+
+	graphics->images = malloc(sizeof(VkImage) * graphics->images_n);
+
+	if(!graphics->images)
+		goto images_malloc_error;
+
+	graphics->image_allocations =
+		malloc(sizeof(struct allocation) * graphics->images_n);
+
+	if(!graphics->image_allocations)
+		goto memories_malloc_error;
+
+	VkImageCreateInfo imageInfo = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = graphics->swapchain_format,
+		.extent = {
+			.width = graphics->swapchain_extent.width,
+			.height = graphics->swapchain_extent.height,
+			.depth = 1
+		},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+			 VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	for(i = 0; i < graphics->images_n; i++) {
+		VkResult res = vkCreateImage(graphics->device, &imageInfo, 0,
+					     graphics->images + i);
+
+		if(res != VK_SUCCESS)
+			goto image_create_error;
+
+		int alloc_res = allocate_image_memory(
+			graphics, graphics->images[i],
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			graphics->image_allocations + i);
+
+		if(alloc_res == -1)
+			alloc_res = allocate_image_memory(
+				graphics, graphics->images[i], 0,
+				graphics->image_allocations + i);
+
+		if(alloc_res == -1) {
+			vkDestroyImage(graphics->device, graphics->images[i], 0);
+			goto image_create_error;
+		}
+	}
+
+	return 0;
+
+image_create_error:
+	while(i--) {
+		vkDestroyImage(graphics->device, graphics->images[i], 0);
+		free_memory(graphics, graphics->image_allocations + i);
+	}
+
+	free(graphics->image_allocations);
+memories_malloc_error:
+	free(graphics->images);
+images_malloc_error:
+	graphics->images_n = 0;
+
+	return -1;
+}
+
 
 int find_swapchain_details(VkPhysicalDevice device, VkSurfaceKHR surface,
 			    struct swapchain_details *swapchain_details)
@@ -1088,40 +2162,157 @@ formats_error:
 	return -1;
 }
 
+/* a 1.0 loader lacks the version query and rejects newer versions */
+static uint32_t get_api_version(void)
+{
+	PFN_vkEnumerateInstanceVersion enumerate_version =
+		(PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(
+			0, "vkEnumerateInstanceVersion");
+	uint32_t version = VK_API_VERSION_1_0;
+
+	if(!enumerate_version || enumerate_version(&version) != VK_SUCCESS)
+		return VK_API_VERSION_1_0;
+
+	return version >= VK_API_VERSION_1_2 ? VK_API_VERSION_1_2 :
+					       VK_API_VERSION_1_0;
+}
+
+/*
+ * optional features the renderer uses when present, the 1.2 ones are left
+ * zeroed unless both the instance and the device are 1.2
+ */
+static void get_device_features(struct Graphics *graphics,
+				VkPhysicalDeviceFeatures *features,
+				VkPhysicalDeviceVulkan12Features *features12)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(graphics->physicalDevice, &properties);
+
+	*features12 = (VkPhysicalDeviceVulkan12Features) {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+	};
+
+	if(graphics->api_version < VK_API_VERSION_1_2 ||
+	   properties.apiVersion < VK_API_VERSION_1_2) {
+		vkGetPhysicalDeviceFeatures(graphics->physicalDevice, features);
+		return;
+	}
+
+	VkPhysicalDeviceFeatures2 features2 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		.pNext = features12
+	};
+
+	vkGetPhysicalDeviceFeatures2(graphics->physicalDevice, &features2);
+
+	*features = features2.features;
+}
+
 int create_logical_device(struct Graphics *graphics)
 {
 	float queue_priority = 1.0;
 
 	VkDeviceQueueCreateInfo queueCreateInfo[queue_families_n];
+	uint32_t queueCreateInfo_n = 0;
 
 	for(int i = 0; i < queue_families_n; i++) {
-		queueCreateInfo[i] = (VkDeviceQueueCreateInfo){
+		uint32_t index = graphics->queue_families.indices[i];
+		int j = 0;
+
+		/* a family may back several roles but is created only once */
+		for(; j < queueCreateInfo_n &&
+		      queueCreateInfo[j].queueFamilyIndex != index; j++);
+
+		if(j != queueCreateInfo_n)
+			continue;
+
+		queueCreateInfo[queueCreateInfo_n++] = (VkDeviceQueueCreateInfo){
 			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-			.queueFamilyIndex = graphics->queue_families.indices[i],
+			.queueFamilyIndex = index,
 			.queueCount = 1,
 			.pQueuePriorities = &queue_priority
 		};
 	}
 
-	VkPhysicalDeviceFeatures deviceFeatures = {};
+	VkPhysicalDeviceFeatures supported;
+	VkPhysicalDeviceVulkan12Features supported12;
+
+	get_device_features(graphics, &supported, &supported12);
 
 	uint32_t extensions_n;
 	const char *const *extensions = get_device_exttensions(&extensions_n);
 
+	if(graphics->flags & graphics_headless_flag)
+		extensions_n = 0;
+
+	VkPhysicalDeviceFeatures deviceFeatures = {
+		.multiDrawIndirect = supported.multiDrawIndirect,
+		.drawIndirectFirstInstance = supported.drawIndirectFirstInstance
+	};
+
+	VkPhysicalDeviceVulkan12Features features12 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.timelineSemaphore = supported12.timelineSemaphore &&
+				     !getenv(NO_TIMELINE_ENV),
+		.drawIndirectCount = supported12.drawIndirectCount
+	};
+
+	/* everything a partially bound, update after bind texture array needs */
+	int bindless = supported12.descriptorIndexing &&
+		       supported12.shaderSampledImageArrayNonUniformIndexing &&
+		       supported12.descriptorBindingSampledImageUpdateAfterBind &&
+		       supported12.descriptorBindingUpdateUnusedWhilePending &&
+		       supported12.descriptorBindingPartiallyBound &&
+		       supported12.runtimeDescriptorArray;
+
+	if(bindless) {
+		features12.descriptorIndexing = VK_TRUE;
+		features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		features12.descriptorBindingPartiallyBound = VK_TRUE;
+		features12.runtimeDescriptorArray = VK_TRUE;
+	}
+
+	int timeline = features12.timelineSemaphore;
+	int indirect = deviceFeatures.multiDrawIndirect &&
+		       deviceFeatures.drawIndirectFirstInstance;
+
+	pdebug("frame synchronization: %s",
+	       timeline ? "timeline semaphore" : "fences");
+	pdebug("indirect draws: %s", !indirect ? "unsupported" :
+	       features12.drawIndirectCount ? "with draw count" : "fixed count");
+
 	VkDeviceCreateInfo createInfo = {
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            .pNext = 0,
-            .queueCreateInfoCount = queue_families_n,
+            .queueCreateInfoCount = queueCreateInfo_n,
             .pQueueCreateInfos = queueCreateInfo,
-            .pEnabledFeatures = 0, //&deviceFeatures,
+            .pEnabledFeatures = &deviceFeatures,
             .enabledExtensionCount = extensions_n,
             .ppEnabledExtensionNames = extensions};
 
+	/* the 1.2 feature struct is only valid on 1.2 devices */
+	if(supported12.timelineSemaphore || supported12.drawIndirectCount ||
+	   bindless)
+		createInfo.pNext = &features12;
+
 	if (vkCreateDevice(graphics->physicalDevice, &createInfo, 0,
 			   &graphics->device) != VK_SUCCESS) {
 		return -1;
 	}
 
+	if(timeline)
+		graphics->flags |= graphics_timeline_flag;
+
+	if(indirect)
+		graphics->flags |= graphics_indirect_flag;
+
+	if(indirect && features12.drawIndirectCount)
+		graphics->flags |= graphics_indirect_count_flag;
+
+	if(bindless)
+		graphics->flags |= graphics_bindless_flag;
+
 	return 0;
 }
 
@@ -1154,6 +2345,9 @@ int pick_physical_device(struct Graphics *graphics)
 		return -1;
 	}
 
+	if(graphics->flags & graphics_headless_flag)
+		return 0;
+
 	graphics->swapchain_extent = graphics->swapchain_details.capabilities.currentExtent;
 
 	return 0;
@@ -1186,9 +2380,11 @@ int create_instance(struct Graphics *graphics, uint32_t extensions_n, const char
 		.applicationVersion = VK_MAKE_VERSION(1, 0, 0),
 		.pEngineName = "No Engeine",
 		.engineVersion = VK_MAKE_VERSION(1, 0, 0),
-		.apiVersion = VK_API_VERSION_1_0
+		.apiVersion = get_api_version()
 	};
 
+	graphics->api_version = appInfo.apiVersion;
+
 
 	VkInstanceCreateInfo createInfo = {
 		.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -1230,7 +2426,12 @@ void find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface,
 		}
 
 		VkBool32 presentSupport = 0;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+
+		/* without a surface, presenting collapses onto graphics */
+		if(surface == VK_NULL_HANDLE)
+			presentSupport = (properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT);
+		else
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
 		
 		if(presentSupport) {
 			queue_families->state |= queue_families_present_flag;
@@ -1238,12 +2439,46 @@ void find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface,
 		}
 	}
 
+	if(!(queue_families->state & queue_families_graphics_flag)) {
+		free(properties);
+		return;
+	}
+
+	uint32_t graphics = queue_families->indices[queue_families_graphics];
+
+	/* roles without a family of their own share the graphics queue */
+	queue_families->indices[queue_families_transfer] = graphics;
+	queue_families->indices[queue_families_compute] = graphics;
+
+	for (int i = 0; i < queue_families_n; i++) {
+		VkQueueFlags flags = properties[i].queueFlags;
+
+		/* a pure copy engine, works next to the graphics queue */
+		if(!(queue_families->state & queue_families_transfer_flag) &&
+		   (flags & VK_QUEUE_TRANSFER_BIT) &&
+		   !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			queue_families->state |= queue_families_transfer_flag;
+			queue_families->indices[queue_families_transfer] = i;
+		}
+
+		if(!(queue_families->state & queue_families_compute_flag) &&
+		   (flags & VK_QUEUE_COMPUTE_BIT) &&
+		   !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+			queue_families->state |= queue_families_compute_flag;
+			queue_families->indices[queue_families_compute] = i;
+		}
+	}
+
 	free(properties);
 }
 
 static int is_device_suitable(struct Graphics *graphics)
 {
-	int res = check_device_extensions_support(graphics->physicalDevice);
+	int headless = graphics->flags & graphics_headless_flag;
+	int res = 0;
+
+	if(!headless)
+		res = check_device_extensions_support(graphics->physicalDevice);
 
 	if(res == -1) {
 		return 0;
@@ -1256,8 +2491,8 @@ static int is_device_suitable(struct Graphics *graphics)
 	      (graphics->queue_families.state & queue_families_present_flag);
 
 
-	if(!res) {
-		return 0;
+	if(!res || headless) {
+		return res;
 	}
 
 	res = find_swapchain_details(graphics->physicalDevice,
@@ -1346,6 +2581,9 @@ get_suitable_device(struct Graphics *graphics, uint32_t devices_n,
 		find_queue_families(graphics->physicalDevice, graphics->surface,
 				    &graphics->queue_families);
 
+		if(graphics->flags & graphics_headless_flag)
+			return;
+
 		int res = find_swapchain_details(graphics->physicalDevice,
 						 graphics->surface,
 						 &graphics->swapchain_details);
@@ -1511,13 +2749,22 @@ static const char *const *get_layers(uint32_t *layers_n)
 }
 
 
-static uint32_t get_images_n(const struct swapchain_details *swapchain_details)
+static uint32_t get_images_n(const struct Graphics *graphics)
 {
-	uint32_t images_n = swapchain_details->capabilities.minImageCount + 1;
+	const VkSurfaceCapabilitiesKHR *capabilities =
+		&graphics->swapchain_details.capabilities;
+
+	uint32_t images_n = graphics->config.images_n ?
+				    graphics->config.images_n :
+				    capabilities->minImageCount + 1;
+
+	if(images_n < capabilities->minImageCount)
+		images_n = capabilities->minImageCount;
 
-	if (images_n > swapchain_details->capabilities.maxImageCount &&
-	    swapchain_details->capabilities.minImageCount > 0) {
-		images_n = swapchain_details->capabilities.maxImageCount;
+	/* a maximum of 0 means no limit */
+	if (images_n > capabilities->maxImageCount &&
+	    capabilities->maxImageCount > 0) {
+		images_n = capabilities->maxImageCount;
 	}
 		
 	return images_n;
@@ -1528,11 +2775,28 @@ static VkExtent2D get_swapextent(const struct swapchain_details *swapchain_detai
 	return swapchain_details->capabilities.currentExtent;
 }
 
-static VkPresentModeKHR get_presentmode(const struct swapchain_details *swapchain_details)
+static VkPresentModeKHR get_presentmode(const struct Graphics *graphics)
 {
+	static const VkPresentModeKHR modes[] = {
+		[graphics_present_default] = VK_PRESENT_MODE_MAILBOX_KHR,
+		[graphics_present_immediate] = VK_PRESENT_MODE_IMMEDIATE_KHR,
+		[graphics_present_mailbox] = VK_PRESENT_MODE_MAILBOX_KHR,
+		[graphics_present_fifo] = VK_PRESENT_MODE_FIFO_KHR,
+		[graphics_present_fifo_relaxed] = VK_PRESENT_MODE_FIFO_RELAXED_KHR
+	};
+
+	const struct swapchain_details *swapchain_details =
+		&graphics->swapchain_details;
+	VkPresentModeKHR wanted = VK_PRESENT_MODE_FIFO_KHR;
+
+	if(graphics->config.present_mode >= 0 &&
+	   graphics->config.present_mode <
+		   (int) (sizeof(modes) / sizeof(modes[0])))
+		wanted = modes[graphics->config.present_mode];
+
 	for(int i = 0; i != swapchain_details->presentmodes_n; i++) {
-		if (swapchain_details->presentmodes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
-			return VK_PRESENT_MODE_MAILBOX_KHR;
+		if (swapchain_details->presentmodes[i] == wanted) {
+			return wanted;
 		}
 	}
 
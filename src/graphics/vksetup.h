@@ -1,11 +1,39 @@
 #include <stdint.h>
 #include <window/window.h>
+#include <graphics/setup.h>
 #include <vulkan/vulkan_core.h>
 
+#include "allocator.h"
+#include "async.h"
+#include "chunkstream.h"
+#include "cull.h"
+#include "descriptors.h"
+#include "textures.h"
+#include "uniforms.h"
+#include "filemap.h"
+#include "instance.h"
+#include "mesh.h"
+#include "particles.h"
+#include "stream.h"
+#include "timeline.h"
+#include "pipelinecache.h"
 #include "vertex.h"
+#include "workers.h"
+
+#define DEFAULT_FRAMES_INFLIGHT 2
 
 enum graphics_flags {
-	graphics_window_resized_flag = 1
+	graphics_window_resized_flag = 1,
+	graphics_headless_flag = 2,
+	graphics_cached_commands_flag = 4,
+	/* the device supports timeline semaphores and they are enabled */
+	graphics_timeline_flag = 8,
+	/* multi draw indirect with a first instance is supported */
+	graphics_indirect_flag = 16,
+	/* and the draw count can come from a buffer */
+	graphics_indirect_count_flag = 32,
+	/* descriptor indexing for the texture array, see textures.h */
+	graphics_bindless_flag = 64
 };
 
 enum shader_types {
@@ -14,14 +42,26 @@ enum shader_types {
 	shaders_n
 };
 
+enum timestamps {
+	timestamp_renderpass_begin,
+	timestamp_draw_end,
+	timestamp_renderpass_end,
+	timestamps_n
+};
+
 enum queue_families_flags {
 	queue_families_graphics_flag = 1,
-	queue_families_present_flag = 2
+	queue_families_present_flag = 2,
+	/* set when the family differs from the graphics one */
+	queue_families_transfer_flag = 4,
+	queue_families_compute_flag = 8
 };
 
 enum queue_families_indices {
 	queue_families_graphics,
 	queue_families_present,
+	queue_families_transfer,
+	queue_families_compute,
 	queue_families_n
 };
 
@@ -40,8 +80,21 @@ struct queue_families {
 	int state;
 };
 
+/* swapchains replaced while frames in flight may still use them */
+#define RETIRED_SWAPCHAINS_MAX 8
+
+struct retired_swapchain {
+	VkSwapchainKHR swapchain;
+	uint32_t views_n;
+	VkImageView *imageviews;
+	VkFramebuffer *framebuffers;
+	/* timeline value of the last submission before it was replaced */
+	uint64_t value;
+};
+
 struct Graphics {
 	VkInstance instance;
+	uint32_t api_version;
 
 	VkSurfaceKHR surface;
 
@@ -49,35 +102,72 @@ struct Graphics {
 	VkDevice device;
 	VkQueue queues[queue_families_n];
 	struct queue_families queue_families;
+
+	struct allocator allocator;
 	
 	VkSwapchainKHR swapchain;
 	VkFormat swapchain_format;
 	VkExtent2D swapchain_extent;
 	struct swapchain_details swapchain_details;
+	struct graphics_config config;
+	uint32_t retired_n;
+	struct retired_swapchain retired[RETIRED_SWAPCHAINS_MAX];
 
 	VkRenderPass renderpass;
+	VkPipelineCache pipelinecache;
 	VkPipeline pipeline;
+	/* the uniform ring's set and struct draw_constants */
 	VkPipelineLayout pipeline_layout;
+	struct descriptors descriptors;
+	struct uniforms uniforms;
+	struct textures textures;
 
 	VkCommandPool commandpool;
+	struct async_queue async[async_queues_n];
 
 	uint32_t current_frame;
 	uint32_t frames_inflight;
 	
 	VkCommandBuffer *commandbuffers;
+
+	/*
+	 * cached mode: one recording per image, reused until the scene
+	 * generation moves past the one it was recorded at
+	 */
+	uint32_t image_commandbuffers_n;
+	VkCommandBuffer *image_commandbuffers;
+	uint64_t *image_generations;
+	/* timeline value of the last submission of each image's recording */
+	uint64_t *image_values;
+	uint64_t scene_generation;
+
+	/* records the scene on worker threads when set */
+	struct workers *workers;
+
 	VkSemaphore *image_available_semaphores;
 	VkSemaphore *render_finished_semaphores;
+	/* only created on the fence fallback */
 	VkFence *inflight_fences;
 
+	struct timeline timeline;
+
+	VkQueryPool querypool;
+	uint64_t timestamp_mask;
+	float timestamp_period;
+	uint32_t *queries_pending;
+
 	uint32_t images_n;
 	VkImage *images;
+	struct allocation *image_allocations;
 
 	uint32_t imageviews_n;
 	VkImageView *imageviews;
 
 
 	size_t shader_sizes[shaders_n];
-	char *shaders[shaders_n];
+	const uint32_t *shaders[shaders_n];
+	/* only mapped while the modules are built from disk overrides */
+	struct filemap shader_files[shaders_n];
 
 	VkShaderModule shadermodules[shaders_n];
 
@@ -85,10 +175,41 @@ struct Graphics {
 	VkFramebuffer *framebuffers;
 
 	uint32_t vertices_n;
-	const struct vertex *vertices;
+	uint32_t indices_n;
+	VkIndexType index_type;
+	/* bounding circle of the mesh */
+	float mesh_center[2];
+	float mesh_radius;
 
 	VkBuffer vertexbuffer;
-	VkDeviceMemory vertex_buffer_memory;
+	struct allocation vertex_allocation;
+
+	VkBuffer indexbuffer;
+	struct allocation index_allocation;
+
+	VkBuffer instancebuffer;
+	struct allocation instance_allocation;
+	/* instances per frame region */
+	uint32_t instance_capacity;
+	struct instance_range *instance_dirty;
+
+	struct stream stream;
+	/* out-of-core chunk file, when one is loaded */
+	struct chunkstream *chunkstream;
+	/* GPU simulated particles, when there are any */
+	struct particles *particles;
+	/* culls the scene on the GPU and draws it indirectly when set */
+	struct cull *cull;
+
+	/* CPU copy every region is filled from */
+	uint32_t instances_n;
+	uint32_t instances_max;
+	struct graphics_instance *instances;
+
+	struct graphics_frame_stats frame_stats;
+
+	/* eventfd counting redraw requests for on-demand loops */
+	int redraw_fd;
 
 	int flags;
 };
@@ -99,28 +220,59 @@ int create_instance(struct Graphics *graphics, uint32_t ext_n,
 int pick_physical_device(struct Graphics *graphics);
 int create_logical_device(struct Graphics *graphics);
 int create_swapchain(struct Graphics *graphics);
+int create_offscreen_images(struct Graphics *graphics);
 int create_imageviews(struct Graphics *graphics);
 int create_renderpass(struct Graphics *graphics);
 int create_shadermodules(struct Graphics *graphics);
 int create_pipeline(struct Graphics *graphics);
+int create_graphics_pipeline(struct Graphics *graphics,
+			     const VkPipelineShaderStageCreateInfo *shader_stages,
+			     const VkPipelineVertexInputStateCreateInfo *vertexInputInfo,
+			     VkPrimitiveTopology topology, VkPipeline *pipeline);
 int create_framebuffers(struct Graphics *graphics);
 int create_vertexbuffer(struct Graphics *graphics);
+int find_memory_type(struct Graphics *graphics, uint32_t filter,
+		     VkMemoryPropertyFlags properties);
+int create_buffer(struct Graphics *graphics, VkDeviceSize size,
+		  VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+		  VkBuffer *buffer, struct allocation *allocation);
+void destroy_buffer(struct Graphics *graphics, VkBuffer buffer,
+		    struct allocation *allocation);
+int upload_buffer(struct Graphics *graphics, VkBuffer buffer,
+		  const void *data, VkDeviceSize size);
+int create_static_buffer(struct Graphics *graphics, VkBufferUsageFlags usage,
+			 const void *data, VkDeviceSize size, VkBuffer *buffer,
+			 struct allocation *allocation);
 int create_commandpool(struct Graphics *graphics);
 int create_commandbuffers(struct Graphics *graphics);
+void destroy_commandbuffers(struct Graphics *graphics);
 
 int recreate_swapchain(struct Graphics *graphics);
+void release_retired_swapchains(struct Graphics *graphics, int idle);
 
 int create_syncobjects(struct Graphics *graphics);
 
 void destroy_syncobjects(struct Graphics *graphics);
+
+int create_querypool(struct Graphics *graphics);
+void destroy_querypool(struct Graphics *graphics);
 void destroy_vertexbuffer(struct Graphics *graphics);
+void destroy_offscreen_images(struct Graphics *graphics);
 
 int draw_frame(struct Graphics *graphics);
 
+VkCommandBuffer begin_onetime_commands(struct Graphics *graphics);
+int end_onetime_commands(struct Graphics *graphics,
+			 VkCommandBuffer commandbuffer);
+/* same, the commands wait for role's last submission before stages */
+int end_onetime_commands_after(struct Graphics *graphics,
+			       VkCommandBuffer commandbuffer, int role,
+			       VkPipelineStageFlags stages);
+
 int record_commandbuffer(struct Graphics *graphics,
 			 VkCommandBuffer commandbuffer, uint32_t image_i);
-
-char *read_binary_file(const char *filename, size_t *size);
+void record_scene(struct Graphics *graphics, VkCommandBuffer commandbuffer,
+		  uint32_t part, uint32_t parts_n);
 
 void find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface,
 			 struct queue_families *queue_families);
@@ -0,0 +1,273 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <helpers/helpers.h>
+#include <vulkan/vulkan_core.h>
+
+#include "vksetup.h"
+#include "workers.h"
+
+static int record_part(struct worker *worker, uint32_t frame,
+		       uint32_t image_i)
+{
+	struct workers *workers = worker->workers;
+	struct Graphics *graphics = workers->graphics;
+	uint32_t slot = frame * workers->workers_n + worker->index;
+
+	VkCommandBuffer commandbuffer = workers->commandbuffers[slot];
+
+	VkResult res = vkResetCommandPool(graphics->device,
+					  workers->commandpools[slot], 0);
+
+	if(res != VK_SUCCESS)
+		return -1;
+
+	VkCommandBufferInheritanceInfo inheritanceInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.renderPass = graphics->renderpass,
+		.subpass = 0,
+		.framebuffer = graphics->framebuffers[image_i]
+	};
+
+	VkCommandBufferBeginInfo beginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+			 VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = &inheritanceInfo
+	};
+
+	res = vkBeginCommandBuffer(commandbuffer, &beginInfo);
+
+	if(res != VK_SUCCESS)
+		return -1;
+
+	record_scene(graphics, commandbuffer, worker->index,
+		     workers->workers_n);
+
+	res = vkEndCommandBuffer(commandbuffer);
+
+	return res == VK_SUCCESS ? 0 : -1;
+}
+
+static void *worker_main(void *arg)
+{
+	struct worker *worker = arg;
+	struct workers *workers = worker->workers;
+	uint64_t job = 0;
+
+	pthread_mutex_lock(&workers->lock);
+
+	for(;;) {
+		while(workers->job == job && !workers->quit)
+			pthread_cond_wait(&workers->start, &workers->lock);
+
+		if(workers->quit)
+			break;
+
+		job = workers->job;
+
+		uint32_t frame = workers->frame;
+		uint32_t image_i = workers->image_i;
+
+		pthread_mutex_unlock(&workers->lock);
+
+		int res = record_part(worker, frame, image_i);
+
+		pthread_mutex_lock(&workers->lock);
+
+		if(res == -1)
+			workers->failed = 1;
+
+		if(!--workers->pending)
+			pthread_cond_signal(&workers->done);
+	}
+
+	pthread_mutex_unlock(&workers->lock);
+
+	return 0;
+}
+
+static int create_commandpools(struct workers *workers)
+{
+	struct Graphics *graphics = workers->graphics;
+	uint32_t slots_n = graphics->frames_inflight * workers->workers_n;
+	uint32_t i;
+
+	workers->commandpools = malloc(sizeof(VkCommandPool) * slots_n);
+
+	if(!workers->commandpools)
+		goto commandpools_malloc_error;
+
+	workers->commandbuffers = malloc(sizeof(VkCommandBuffer) * slots_n);
+
+	if(!workers->commandbuffers)
+		goto commandbuffers_malloc_error;
+
+	VkCommandPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex =
+			graphics->queue_families.indices[queue_families_graphics]
+	};
+
+	for(i = 0; i < slots_n; i++) {
+		VkResult res = vkCreateCommandPool(graphics->device, &poolInfo,
+						   0, workers->commandpools + i);
+
+		if(res != VK_SUCCESS)
+			goto commandpool_create_error;
+
+		VkCommandBufferAllocateInfo allocInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = workers->commandpools[i],
+			.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+			.commandBufferCount = 1
+		};
+
+		res = vkAllocateCommandBuffers(graphics->device, &allocInfo,
+					       workers->commandbuffers + i);
+
+		if(res != VK_SUCCESS) {
+			vkDestroyCommandPool(graphics->device,
+					     workers->commandpools[i], 0);
+			goto commandpool_create_error;
+		}
+	}
+
+	return 0;
+
+commandpool_create_error:
+	while(i--)
+		vkDestroyCommandPool(graphics->device, workers->commandpools[i],
+				     0);
+
+	free(workers->commandbuffers);
+commandbuffers_malloc_error:
+	free(workers->commandpools);
+commandpools_malloc_error:
+	return -1;
+}
+
+static void destroy_commandpools(struct workers *workers)
+{
+	struct Graphics *graphics = workers->graphics;
+	uint32_t slots_n = graphics->frames_inflight * workers->workers_n;
+
+	for(uint32_t i = 0; i < slots_n; i++)
+		vkDestroyCommandPool(graphics->device, workers->commandpools[i],
+				     0);
+
+	free(workers->commandbuffers);
+	free(workers->commandpools);
+}
+
+/* stops and joins the first threads_n workers */
+static void stop_threads(struct workers *workers, uint32_t threads_n)
+{
+	pthread_mutex_lock(&workers->lock);
+	workers->quit = 1;
+	pthread_cond_broadcast(&workers->start);
+	pthread_mutex_unlock(&workers->lock);
+
+	for(uint32_t i = 0; i < threads_n; i++)
+		pthread_join(workers->workers[i].thread, 0);
+}
+
+struct workers *workers_new(struct Graphics *graphics, uint32_t workers_n)
+{
+	uint32_t i;
+
+	struct workers *workers = calloc(1, sizeof(struct workers));
+
+	if(!workers)
+		goto workers_malloc_error;
+
+	workers->graphics = graphics;
+	workers->workers_n = workers_n;
+
+	workers->workers = calloc(workers_n, sizeof(struct worker));
+
+	if(!workers->workers)
+		goto worker_malloc_error;
+
+	if(create_commandpools(workers) == -1)
+		goto commandpools_error;
+
+	pthread_mutex_init(&workers->lock, 0);
+	pthread_cond_init(&workers->start, 0);
+	pthread_cond_init(&workers->done, 0);
+
+	for(i = 0; i < workers_n; i++) {
+		workers->workers[i].index = i;
+		workers->workers[i].workers = workers;
+
+		if(pthread_create(&workers->workers[i].thread, 0, worker_main,
+				  workers->workers + i))
+			goto thread_create_error;
+	}
+
+	pdebug("recording with %u worker threads", workers_n);
+
+	return workers;
+
+thread_create_error:
+	stop_threads(workers, i);
+
+	pthread_cond_destroy(&workers->done);
+	pthread_cond_destroy(&workers->start);
+	pthread_mutex_destroy(&workers->lock);
+
+	destroy_commandpools(workers);
+commandpools_error:
+	free(workers->workers);
+worker_malloc_error:
+	free(workers);
+workers_malloc_error:
+	return 0;
+}
+
+void workers_delete(struct workers *workers)
+{
+	stop_threads(workers, workers->workers_n);
+
+	pthread_cond_destroy(&workers->done);
+	pthread_cond_destroy(&workers->start);
+	pthread_mutex_destroy(&workers->lock);
+
+	destroy_commandpools(workers);
+
+	free(workers->workers);
+	free(workers);
+}
+
+void workers_begin(struct workers *workers, uint32_t image_i)
+{
+	pthread_mutex_lock(&workers->lock);
+
+	workers->frame = workers->graphics->current_frame;
+	workers->image_i = image_i;
+	workers->pending = workers->workers_n;
+	workers->failed = 0;
+	workers->job++;
+
+	pthread_cond_broadcast(&workers->start);
+	pthread_mutex_unlock(&workers->lock);
+}
+
+const VkCommandBuffer *workers_wait(struct workers *workers)
+{
+	pthread_mutex_lock(&workers->lock);
+
+	while(workers->pending)
+		pthread_cond_wait(&workers->done, &workers->lock);
+
+	int failed = workers->failed;
+
+	pthread_mutex_unlock(&workers->lock);
+
+	if(failed)
+		return 0;
+
+	return workers->commandbuffers + workers->frame * workers->workers_n;
+}
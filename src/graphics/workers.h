@@ -0,0 +1,52 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+struct Graphics;
+struct workers;
+
+struct worker {
+	pthread_t thread;
+	uint32_t index;
+	struct workers *workers;
+};
+
+/*
+ * Records the scene as secondary command buffers, one slice per worker.
+ * Every worker owns a transient pool per frame in flight, so a frame only
+ * resets pools whose previous submission has already retired.
+ */
+struct workers {
+	struct Graphics *graphics;
+
+	uint32_t workers_n;
+	struct worker *workers;
+
+	/* indexed by frame * workers_n + worker */
+	VkCommandPool *commandpools;
+	VkCommandBuffer *commandbuffers;
+
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+
+	uint64_t job;
+	uint32_t frame;
+	uint32_t image_i;
+	uint32_t pending;
+	int failed;
+	int quit;
+};
+
+struct workers *workers_new(struct Graphics *graphics, uint32_t workers_n);
+void workers_delete(struct workers *workers);
+
+/* starts recording the current frame for image_i in the background */
+void workers_begin(struct workers *workers, uint32_t image_i);
+/* waits for workers_begin, returns the frame's secondaries or 0 */
+const VkCommandBuffer *workers_wait(struct workers *workers);
+
+#endif
@@ -8,6 +8,7 @@
 #include "xcb_window.h"
 #include <xcb/xproto.h>
 #include <helpers/helpers.h>
+#include <helpers/timer.h>
 
 uint32_t window_height(const Window *window);
 uint32_t window_width(const Window *window);
@@ -33,6 +34,43 @@ uint32_t window_get_width(const Window *window)
 	return window->width;
 }
 
+void window_set_resize_settle(Window *window, uint32_t settle_ms)
+{
+	window->settle_ns = (uint64_t) settle_ms * 1000000;
+}
+
+int window_get_fd(const Window *window)
+{
+	return xcb_get_file_descriptor(window->conn);
+}
+
+int window_get_timeout(const Window *window)
+{
+	if(!window->resize_pending)
+		return -1;
+
+	uint64_t elapsed = timer_now_ns() - window->resize_ns;
+
+	if(elapsed >= window->settle_ns)
+		return 0;
+
+	/* rounded up so the wait does not end just short of settling */
+	return (window->settle_ns - elapsed + 999999) / 1000000;
+}
+
+/* restarts the settle time on every size change of a burst */
+static inline void mark_resize(Window *window)
+{
+	window->resize_pending = 1;
+	window->resize_ns = timer_now_ns();
+}
+
+static inline int resize_settled(const Window *window)
+{
+	return window->resize_pending &&
+	       timer_now_ns() - window->resize_ns >= window->settle_ns;
+}
+
 static inline void proccess_resize_request(Window *window,
 					   xcb_generic_event_t *generic_event)
 {
@@ -83,18 +121,18 @@ int window_poll_event(Window *window, window_event_t *window_event)
 		xcb_generic_event_t *event = xcb_poll_for_event(window->conn);
 
 		if (!event)
-			return 0;
+			break;
 		switch (event->response_type & ~0x80) {
 		case XCB_CONFIGURE_NOTIFY:
 			if(is_configure_resize_notify(window, event)) {
 				proccess_configure_resize_notify(window, event);
-				window_event->event_type = resize_event_type;
+				mark_resize(window);
 			}
 			break;
 
 		case XCB_RESIZE_REQUEST:
 			proccess_resize_request(window, event);
-			window_event->event_type = resize_event_type;
+			mark_resize(window);
 			break;
 		case XCB_CLIENT_MESSAGE: 
 			if(is_close_client_event(window, event))
@@ -111,6 +149,14 @@ int window_poll_event(Window *window, window_event_t *window_event)
 
 	} while (!done);
 
+	/* the queue is drained, report the burst's final size if it settled */
+	if(resize_settled(window)) {
+		window->resize_pending = 0;
+		window_event->event_type = resize_event_type;
+		window_event->info = 0;
+		return 1;
+	}
+
 	return 0;
 }
 
@@ -168,6 +214,9 @@ Window *window_new(int width, int height, const char *name)
 	window->height = height;
 	window->width = width;
 
+	window->resize_pending = 0;
+	window_set_resize_settle(window, WINDOW_RESIZE_SETTLE_MS);
+
 	return window;
 }
 
@@ -9,6 +9,11 @@ struct Window {
 
 	uint16_t width;
 	uint16_t height;
+
+	/* a resize is reported once the size stopped changing for settle_ns */
+	int resize_pending;
+	uint64_t resize_ns;
+	uint64_t settle_ns;
 };
 
 struct window_event_info {